@@ -7,12 +7,19 @@
 #include <FLD-SDK-API-PUBLIC.h>
 
 #include "fld_image_utils.h"
+#include "fld_runtime_utils.h"
+#include "fld_metrics_utils.h"
+#include "fld_parallel_utils.h"
+#include "fld_log_utils.h"
 #include <chrono>
 #include <vector>
 #include <algorithm>
 #include <random>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <new>
+#include <memory>
 #if defined(_WIN32)
 #include <algorithm> // std::replace
 #endif
@@ -33,7 +40,6 @@ static const char* __jsonConfig =
 "\"debug_write_input_image_enabled\": false,"
 "\"debug_internal_data_path\": \".\","
 ""
-"\"num_threads\": -1,"
 "\"gpgpu_enabled\": true,"
 "\"max_latency\": -1,"
 "\"image_interpolation\": \"bicubic\","
@@ -43,14 +49,12 @@ static const char* __jsonConfig =
 "\"openvino_enabled\": false,"
 "\"openvino_device\": \"CPU\","
 ""
-"\"detect_tf_num_threads\": -1,"
 "\"detect_tf_gpu_memory_alloc_max_percent\": 0.2,"
 "\"detect_roi\": [0, 0, 0, 0],"
 "\"detect_minscore\": 0.9,"
 "\"detect_face_minsize\": 128,"
 ""
 "\"liveness_detect_enabled\": true,"
-"\"liveness_tf_num_threads\": -1,"
 "\"liveness_tf_gpu_memory_alloc_max_percent\": 0.2,"
 "\"liveness_face_minsize\": 128,"
 "\"liveness_genuine_minscore\": 0.98,"
@@ -58,44 +62,76 @@ static const char* __jsonConfig =
 "\"liveness_toofar_threshold\": 0.5,"
 ""
 "\"deepfake_detect_enabled\": true,"
-"\"deepfake_tf_num_threads\": -1,"
 "\"deepfake_tf_gpu_memory_alloc_max_percent\": 0.2,"
 "\"deepfake_minscore\": 0.5,"
 ""
 "\"disguise_detect_enabled\": true,"
-"\"disguise_tf_num_threads\": -1,"
 "\"disguise_tf_gpu_memory_alloc_max_percent\": 0.2,"
 "\"disguise_minscore\": 0.5"
 ""
 ;
 
+#if !defined(NDEBUG)
+/*
+* Builds without NDEBUG only (debug builds, also CMake builds with no build type): count the heap allocations to check that
+* processing doesn't allocate once the engine is warmed up. Allocations done using malloc() instead of operator new are not counted.
+*/
+static std::atomic<size_t> heapAllocCount(0);
+void* operator new(size_t size)
+{
+	heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+	void* ptr = ::malloc(size ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+void operator delete(void* ptr) noexcept
+{
+	::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept // Sized version (C++14)
+{
+	::free(ptr);
+}
+#endif /* !NDEBUG */
+
 /*
 * Parallel callback function used for notification. Not mandatory.
 * More info about parallel delivery: https://www.doubango.org/SDKs/anpr/docs/Parallel_versus_sequential_processing.html
 */
-static size_t parallelNotifCount = 0;
-static std::condition_variable parallelNotifCondVar;
+static FldDeliveryTracker deliveryTracker;
+static std::atomic<long long> parallelLastDeliveryTime(0); // high_resolution_clock ticks since epoch
+static FldMetrics metrics;
+static std::unique_ptr<FldTracer> tracer; // Only when tracing is enabled
 class MyFldSdkParallelDeliveryCallback : public FldSdkParallelDeliveryCallback {
 public:
 	MyFldSdkParallelDeliveryCallback(const void* userData) : m_pMyDummyData(userData) {}
 	virtual void onNewResult(const FldSdkResult* result) const override {
 		// Use m_pMyDummyData here if you want
 		FLD_SDK_ASSERT(result != nullptr);
-		const std::string& json = result->json();
-		// Printing to the console could be very slow and delayed -> stop displaying the result as soon as all faces are processed
-		FLD_SDK_PRINT_INFO("MyFldSdkParallelDeliveryCallback::onNewResult(%d, %s, %zu): %s",
+		// No std::string copy: this is called for every frame and the JSON string is owned by the result
+		const char* json = result->json();
+		// Printing to the console could be very slow and delayed -> use the async logger to not block the engine's delivery thread
+		FLD_ASYNC_PRINT_INFO("MyFldSdkParallelDeliveryCallback::onNewResult(%d, %s, %zu): %s",
 			result->code(),
 			result->phrase(),
-			++parallelNotifCount,
-			!json.empty() ? json.c_str() : "{}"
+			deliveryTracker.delivered() + 1,
+			(json && *json) ? json : "{}"
 		);
-		parallelNotifCondVar.notify_one();
+		metrics.onResult(result);
+		if (tracer) {
+			tracer->instant("delivery");
+		}
+		parallelLastDeliveryTime.store(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+		deliveryTracker.onDelivered(); // Last: wakes up flush()
 	}
 private:
 	const void* m_pMyDummyData;
 };
 
 static void printUsage(const std::string& message = "");
+static void printMemoryUsage(const char* stage, const FldMemoryUsage& usage, const FldMemoryUsage& previous);
 
 int main(int argc, char *argv[])
 {
@@ -105,7 +141,10 @@ int main(int argc, char *argv[])
 	std::string assetsFolder, licenseTokenData, licenseTokenFile;
 	bool isParallelDeliveryEnabled = true;
 	size_t loopCount = 100;
-	std::string imagePath;
+	size_t cpuBudget = 0;
+	std::vector<int> cpus;
+	bool isPhysicalCoresOnly = false;
+	std::string imagePath, metricsFile, traceFile;
 
 	// Parsing args
 	std::map<std::string, std::string > args;
@@ -134,6 +173,30 @@ int main(int argc, char *argv[])
 	if (args.find("--parallel") != args.end()) {
 		isParallelDeliveryEnabled = (args["--parallel"].compare("true") == 0);
 	}
+	if (args.find("--threads") != args.end()) {
+		const int threads = std::atoi(args["--threads"].c_str());
+		if (threads < 0) {
+			printUsage("--threads must be within [0, inf]");
+			return -1;
+		}
+		cpuBudget = static_cast<size_t>(threads);
+	}
+	if (args.find("--cpuset") != args.end()) {
+		if (!fldParseCpuList(args["--cpuset"], cpus)) {
+			printUsage("--cpuset must be a CPU list (e.g. 0-3,8)");
+			return -1;
+		}
+	}
+	if (args.find("--physical_cores_only") != args.end()) {
+		isPhysicalCoresOnly = (args["--physical_cores_only"].compare("true") == 0);
+	}
+	if (args.find("--metrics_file") != args.end()) {
+		metricsFile = args["--metrics_file"];
+	}
+	if (args.find("--trace_file") != args.end()) {
+		traceFile = args["--trace_file"];
+		tracer.reset(new FldTracer());
+	}
 	if (args.find("--assets") != args.end()) {
 		assetsFolder = args["--assets"];
 #if defined(_WIN32)
@@ -152,8 +215,29 @@ int main(int argc, char *argv[])
 	}
 
 
+	// Pin the engine's threads: must be done before init as the threads inherit the affinity
+	if (isPhysicalCoresOnly) {
+		cpus = fldPhysicalCores(cpus);
+		if (cpus.empty()) {
+			FLD_SDK_PRINT_ERROR("No physical core to pin the engine to");
+			return -1;
+		}
+	}
+	if (!cpus.empty()) {
+		if (!fldSetAffinity(cpus)) {
+			return -1;
+		}
+		if (!cpuBudget) {
+			cpuBudget = std::min(cpus.size(), fldCpuCount(true)); // After pinning: also honors the cgroup quota
+		}
+	}
+
 	// Update JSON config
+	const std::chrono::high_resolution_clock::time_point configStart = std::chrono::high_resolution_clock::now();
 	std::string jsonConfig = __jsonConfig;
+	const std::string threadingConfig = fldBuildThreadingConfig(cpuBudget, isParallelDeliveryEnabled).toJson();
+	FLD_SDK_PRINT_INFO("Threading config: %s", threadingConfig.c_str() + 1);
+	jsonConfig += threadingConfig;
 	if (!assetsFolder.empty()) {
 		jsonConfig += std::string(",\"assets_folder\": \"") + assetsFolder + std::string("\"");
 	}
@@ -165,35 +249,75 @@ int main(int argc, char *argv[])
 	}
 
 	jsonConfig += "}"; // end-of-config
+	const double configTimeInMillis = fldElapsedMillis(configStart);
 
 	// Decode image
 	FldFile fldFile;
+	const std::chrono::high_resolution_clock::time_point decodeStart = std::chrono::high_resolution_clock::now();
 	if (!fldDecodeFile(imagePath, fldFile)) {
 		FLD_SDK_PRINT_INFO("Failed to read image file: %s", imagePath.c_str());
 		return -1;
 	}
+	const double decodeTimeInMillis = fldElapsedMillis(decodeStart);
+
+	// Memory usage at each stage: the deltas tell which stage (models loading, warmup, processing) is responsible
+	FldMemoryUsage memoryBeforeInit, memoryAfterInit, memoryAfterWarmUp, memoryAfterProcessing;
+	fldMemoryUsage(memoryBeforeInit);
 
 	// Init
 	FLD_SDK_PRINT_INFO("Starting benchmark...");
+	const std::chrono::high_resolution_clock::time_point initStart = std::chrono::high_resolution_clock::now();
 	FLD_SDK_ASSERT((result = FldSdkEngine::init(
 		ASSET_MGR_PARAM()
 		jsonConfig.c_str(),
 		isParallelDeliveryEnabled ? &parallelDeliveryCallbackCallback : nullptr
 	)).isOK());
+	const double initTimeInMillis = fldElapsedMillis(initStart);
+	if (tracer) {
+		tracer->complete("init", initStart);
+	}
 
 	// WarmUp: Force loading the models in memory (slow for first time) now and perform warmup calls.
 	// Warmup not required by processing will be fast if you call warm up first.
+	fldMemoryUsage(memoryAfterInit);
+	const std::chrono::high_resolution_clock::time_point warmUpStart = std::chrono::high_resolution_clock::now();
 	FLD_SDK_ASSERT((result = FldSdkEngine::warmUp(fldFile.type)).isOK());
+	const double warmUpTimeInMillis = fldElapsedMillis(warmUpStart);
+	if (tracer) {
+		tracer->complete("warmUp", warmUpStart);
+	}
+	fldMemoryUsage(memoryAfterWarmUp);
 
 	// Processing
+#if !defined(NDEBUG)
+	FldAsyncLogger::instance(); // Created by the first log from the callback: not part of the processing allocations
+	const size_t heapAllocCountStart = heapAllocCount.load();
+#endif /* !NDEBUG */
+	// In sequential mode the latency of each process() call is the latency of the whole pipeline (detection + liveness checks).
+	// In parallel mode it's the time needed to enqueue the frame, the delivery latency is computed using the callback.
+	FldLatencySamples processLatencies;
+	processLatencies.reserve(loopCount);
 	const std::chrono::high_resolution_clock::time_point timeStart = std::chrono::high_resolution_clock::now();
 	for (size_t i = 0; i < loopCount; ++i) {
+		const std::chrono::high_resolution_clock::time_point callStart = std::chrono::high_resolution_clock::now();
+		if (isParallelDeliveryEnabled) {
+			deliveryTracker.onSubmitted(); // Before process(): the result could be delivered before the function returns
+		}
 		FLD_SDK_ASSERT((result = FldSdkEngine::process(
 			fldFile.type,
 			fldFile.uncompressedData,
 			fldFile.width,
 			fldFile.height
 		)).isOK());
+		const double processLatency = fldElapsedMillis(callStart);
+		processLatencies.add(processLatency);
+		metrics.onSubmitted(processLatency);
+		if (tracer) {
+			tracer->complete("process", callStart, static_cast<long long>(i));
+		}
+		if (!isParallelDeliveryEnabled) {
+			metrics.onResult(&result);
+		}
 	}
 	// Compute the estimated frame rate.
 	// At this step all frames are already processed but the result could be still on the delivery
@@ -202,34 +326,68 @@ int main(int argc, char *argv[])
 	const std::chrono::high_resolution_clock::time_point timeEnd = std::chrono::high_resolution_clock::now();
 	const double elapsedTimeInMillis = std::chrono::duration_cast<std::chrono::duration<double >>(timeEnd - timeStart).count() * 1000.0;
 	FLD_SDK_PRINT_INFO("Elapsed time (Liveness) = [[[ %lf millis ]]]", elapsedTimeInMillis);
+#if !defined(NDEBUG)
+	const size_t heapAllocCountProcessing = heapAllocCount.load() - heapAllocCountStart;
+	FLD_SDK_PRINT_INFO("Heap allocations (operator new) while processing: %zu (%lf per frame)",
+		heapAllocCountProcessing, heapAllocCountProcessing / (double)loopCount);
+#endif /* !NDEBUG */
 
 	// Printing to the console is very slow and use a low priority thread.
 	// Wait until all results are displayed.
+	size_t pendingCount = 0;
 	if (isParallelDeliveryEnabled) {
-		static std::mutex parallelNotifMutex;
-		std::unique_lock<std::mutex > lk(parallelNotifMutex);
-		parallelNotifCondVar.wait_for(lk,
-			std::chrono::milliseconds(1500), // maximum number of millis to wait for before giving up, must never wait this long
-			[&loopCount] { return (parallelNotifCount == loopCount); }
+		// maximum number of millis to wait for before giving up, must never wait this long
+		if ((pendingCount = deliveryTracker.flush(std::chrono::milliseconds(1500))) != 0) {
+			FLD_SDK_PRINT_WARN("%zu result(s) still pending", pendingCount);
+		}
+	}
+
+	fldMemoryUsage(memoryAfterProcessing);
+
+	// Print timings
+	// Init includes the license checks, the config parsing and the plugins loading. The models are
+	// loaded and the warmup inferences done in warmUp.
+	FLD_SDK_PRINT_INFO("Startup: config = %lf millis, decoding = %lf millis, init = %lf millis, warmUp = %lf millis",
+		configTimeInMillis, decodeTimeInMillis, initTimeInMillis, warmUpTimeInMillis);
+	FLD_SDK_PRINT_INFO("process() latency: %s", processLatencies.summary().c_str());
+	if (isParallelDeliveryEnabled && !pendingCount) {
+		const std::chrono::high_resolution_clock::time_point lastDeliveryTime{ std::chrono::high_resolution_clock::duration(parallelLastDeliveryTime.load()) };
+		FLD_SDK_PRINT_INFO("Time from first submission to last delivery: %lf millis",
+			std::chrono::duration_cast<std::chrono::duration<double >>(lastDeliveryTime - timeStart).count() * 1000.0
 		);
 	}
 
 	// Print latest result
-	const std::string& json_ = result.json();
-	if (!json_.empty()) {
-		FLD_SDK_PRINT_INFO("result: %s", json_.c_str());
+	const char* json = result.json();
+	if (json && *json) {
+		FLD_SDK_PRINT_INFO("result: %s", json);
 	}
 
 	// Print estimated frame rate
 	const double estimatedFps = 1000.f / (elapsedTimeInMillis / (double)loopCount);
 	FLD_SDK_PRINT_INFO("*** elapsedTimeInMillis: %lf, estimatedFps: %lf ***", elapsedTimeInMillis, estimatedFps);
 
+	// Export metrics
+	if (!metricsFile.empty() && metrics.writePrometheus(metricsFile)) {
+		FLD_SDK_PRINT_INFO("Metrics written to %s", metricsFile.c_str());
+	}
+
+	// Print memory usage
+	printMemoryUsage("init", memoryAfterInit, memoryBeforeInit);
+	printMemoryUsage("warmUp", memoryAfterWarmUp, memoryAfterInit);
+	printMemoryUsage("processing", memoryAfterProcessing, memoryAfterWarmUp);
+
 	FLD_SDK_PRINT_INFO("Press any key to terminate !!");
 	getchar();
 
 	// DeInit
 	FLD_SDK_PRINT_INFO("Ending benchmark...");
-	FLD_SDK_ASSERT((result = FldSdkEngine::deInit()).isOK());
+	FLD_SDK_ASSERT((result = fldDeInit(isParallelDeliveryEnabled ? &deliveryTracker : nullptr, FLD_DRAIN_POLICY_WAIT, std::chrono::milliseconds(1500))).isOK());
+
+	// Export trace: after deInit as the engine's threads could still be recording deliveries (flush timeout)
+	if (tracer && tracer->write(traceFile)) {
+		FLD_SDK_PRINT_INFO("Trace written to %s (%llu event(s) dropped)", traceFile.c_str(), tracer->dropped());
+	}
 
 	return 0;
 }
@@ -247,6 +405,11 @@ static void printUsage(const std::string& message /*= ""*/)
 		"\t--assets <path-to-assets-folder> \n"
 		"\t[--loops <number-of loops>] \n"
 		"\t[--parallel <whether-to-enable-parallel-mode:true / false>] \n"
+		"\t[--threads <number-of-cpus-to-use>] \n"
+		"\t[--cpuset <list-of-cpus-to-pin-the-engine-to>] \n"
+		"\t[--physical_cores_only <whether-to-skip-hyperthread-siblings:true / false>] \n"
+		"\t[--metrics_file <path-to-prometheus-text-file>] \n"
+		"\t[--trace_file <path-to-chrome-trace-json-file>] \n"
 		"\t[--tokenfile <path-to-license-token-file>] \n"
 		"\t[--tokendata <base64-license-token-data>] \n"
 		"\n"
@@ -256,8 +419,26 @@ static void printUsage(const std::string& message /*= ""*/)
 		"--assets: Path to the assets folder containing the configuration files and models.\n\n"
 		"--loops: Number of times to run the processing function. Default: 100. \n\n"
 		"--parallel: Whether to enabled the parallel mode. More info about the parallel mode at https ://www.doubango.org/SDKs/anpr/docs/Parallel_versus_sequential_processing.html. Default: true.\n\n"
+		"--threads: Number of CPUs shared by the engine and the models. Zero means all the CPUs available to the process (affinity mask and cgroup quota). Default: 0.\n\n"
+		"--cpuset: List of CPUs to pin the engine's threads to (e.g. 0-3,8). Linux only. Default: null.\n\n"
+		"--physical_cores_only: Whether to use a single logical CPU per physical core to avoid hyperthread contention. Linux only. Default: false.\n\n"
+		"--metrics_file: Path to the file where to write the metrics (frames, faces, verdicts, latency histogram) using Prometheus text format. Default: null.\n\n"
+		"--trace_file: Path to the file where to write the trace events (init, warmUp, process calls and deliveries) using Chrome trace-event JSON format. Default: null.\n\n"
 		"--tokenfile: Path to the file containing the base64 license token if you have one. If not provided then, the application will act like a trial version. Default: null.\n\n"
 		"--tokendata: Base64 license token if you have one. If not provided then, the application will act like a trial version. Default: null.\n\n"
 		"********************************************************************************\n"
 	);
+}
+
+static void printMemoryUsage(const char* stage, const FldMemoryUsage& usage, const FldMemoryUsage& previous)
+{
+	if (!usage.residentBytes) {
+		return; // Not available on this platform
+	}
+	FLD_SDK_PRINT_INFO("Memory after %s: resident = %.2f MB (%+.2f MB), peak = %.2f MB",
+		stage,
+		usage.residentBytes / (1024.0 * 1024.0),
+		(static_cast<double>(usage.residentBytes) - static_cast<double>(previous.residentBytes)) / (1024.0 * 1024.0),
+		usage.peakResidentBytes / (1024.0 * 1024.0)
+	);
 }
\ No newline at end of file
@@ -0,0 +1,248 @@
+#if !defined(_FACE_LIVENESS_SDK_SAMPLES_DUMP_UTILS_H_)
+#define _FACE_LIVENESS_SDK_SAMPLES_DUMP_UTILS_H_
+
+#include <FLD-SDK-API-PUBLIC.h>
+#include "fld_result_utils.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+using namespace FaceLiveness;
+
+/*
+* Input dumper configuration
+*/
+struct FldDumpConfig {
+	/*! Folder where to write the inputs, must exist */
+	std::string folder = ".";
+	/*! Only one frame out of "sampleEvery" is candidate for dumping. 1 means all frames */
+	size_t sampleEvery = 1;
+	/*! Only dump the frames with at least one of these "liveness_code" values (e.g. "s_spoof", "s_deepfake"). Empty means all frames */
+	std::vector<std::string> verdicts;
+	/*! Maximum number of bytes written per second, extra frames are dropped (a frame bigger than this is never dumped). Zero means no limit */
+	size_t maxBytesPerSecond = 0;
+	/*! Number of buffers in the pool, i.e. maximum number of frames waiting to be written */
+	size_t numBuffers = 4;
+};
+
+/*
+* Computes the size in bytes of an image passed to FldSdkEngine::process() as a single buffer.
+* @param type Image type.
+* @param width Width in samples.
+* @param height Height in samples.
+* @param stride Stride in samples, zero means same as the width.
+* @returns the size in bytes
+*/
+static size_t fldImageSizeInBytes(const FLD_SDK_IMAGE_TYPE type, const size_t width, const size_t height, size_t stride = 0)
+{
+	stride = stride ? stride : width;
+	const size_t lumaSize = stride * height;
+	switch (type) {
+	case FLD_SDK_IMAGE_TYPE_RGB24:
+	case FLD_SDK_IMAGE_TYPE_BGR24:
+		return lumaSize * 3;
+	case FLD_SDK_IMAGE_TYPE_RGBA32:
+	case FLD_SDK_IMAGE_TYPE_BGRA32:
+		return lumaSize * 4;
+	case FLD_SDK_IMAGE_TYPE_NV12:
+	case FLD_SDK_IMAGE_TYPE_NV21:
+	case FLD_SDK_IMAGE_TYPE_YUV420P:
+	case FLD_SDK_IMAGE_TYPE_YVU420P:
+		return lumaSize + (((stride + 1) >> 1) * ((height + 1) >> 1) * 2);
+	case FLD_SDK_IMAGE_TYPE_YUV422P:
+		return lumaSize + (((stride + 1) >> 1) * height * 2);
+	case FLD_SDK_IMAGE_TYPE_YUV444P:
+		return lumaSize * 3;
+	case FLD_SDK_IMAGE_TYPE_Y:
+	default:
+		return lumaSize;
+	}
+}
+
+/*
+* Checks whether a result contains at least one face with a "liveness_code" from the list.
+*/
+static bool fldResultHasVerdict(const FldSdkResult* result, const std::vector<std::string>& verdicts)
+{
+	bool found = false;
+	fldForEachLivenessCode(result->json(), [&verdicts, &found](const char* code, const size_t length) -> bool {
+		for (std::vector<std::string>::const_iterator it = verdicts.begin(); it != verdicts.end(); ++it) {
+			if (it->size() == length && strncmp(it->c_str(), code, length) == 0) {
+				found = true;
+				return false;
+			}
+		}
+		return true;
+	});
+	return found;
+}
+
+/*
+* Host-side replacement for the engine's "debug_write_input_image_enabled" entry which can stay enabled in production:
+* the frames are sampled, filtered on the verdict and rate limited, then copied to a pooled buffer and written to disk by
+* a background thread. The calling thread never does file I/O and the pixel buffers are reused once the pool is warm.
+* A frame is dropped (and counted) when the byte budget is exhausted or when all the buffers are waiting to be written.
+*/
+class FldInputDumper {
+public:
+	FldInputDumper(const FldDumpConfig& config)
+		: m_Config(config)
+		, m_nFrames(0)
+		, m_nDumped(0)
+		, m_nDropped(0)
+		, m_nBudget(static_cast<double>(config.maxBytesPerSecond))
+		, m_BudgetTime(std::chrono::steady_clock::now())
+		, m_bRunning(true) {
+		m_Config.sampleEvery = std::max<size_t>(m_Config.sampleEvery, 1);
+		m_Free.resize(std::max<size_t>(m_Config.numBuffers, 1));
+		m_Thread = std::thread(&FldInputDumper::run, this);
+	}
+
+	/*
+	* Writes the pending frames then stops the writer thread.
+	*/
+	virtual ~FldInputDumper() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_bRunning = false;
+		}
+		m_CondVar.notify_one();
+		m_Thread.join();
+		const size_t dropped = m_nDropped.load();
+		if (dropped) {
+			FLD_SDK_PRINT_WARN("%zu input(s) not dumped (budget exceeded or no free buffer)", dropped);
+		}
+	}
+
+	/*
+	* Dumps a raw image passed to FldSdkEngine::process() as a single buffer.
+	* @param result The result returned by process() in sequential mode. Null in parallel mode, where the frames can't be
+	* matched with the delivered results: nothing is dumped when a verdict filter is set.
+	* @returns true if the frame was queued for writing
+	*/
+	bool dump(const FLD_SDK_IMAGE_TYPE type, const void* data, const size_t width, const size_t height, const size_t stride, const FldSdkResult* result) {
+		char extension[64];
+		snprintf(extension, sizeof(extension), "%zux%zu_%d.raw", stride ? stride : width, height, static_cast<int>(type));
+		return dump(data, fldImageSizeInBytes(type, width, height, stride), extension, result);
+	}
+
+	/*
+	* Dumps any input buffer (e.g. the encoded JPEG/PNG data).
+	* @param extension Suffix added to the file name.
+	* @returns true if the frame was queued for writing
+	*/
+	bool dump(const void* data, const size_t size, const char* extension, const FldSdkResult* result) {
+		const size_t index = m_nFrames.fetch_add(1, std::memory_order_relaxed);
+		if (index % m_Config.sampleEvery) {
+			return false;
+		}
+		if (!m_Config.verdicts.empty() && (!result || !fldResultHasVerdict(result, m_Config.verdicts))) {
+			return false;
+		}
+		std::vector<uint8_t> buffer;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Free.empty() || !consumeBudget(size)) { // No free buffer: the frame doesn't use the budget
+				m_nDropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			buffer.swap(m_Free.back());
+			m_Free.pop_back();
+		}
+		buffer.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size); // Reuses the capacity
+		Frame frame;
+		frame.buffer.swap(buffer);
+		frame.path = m_Config.folder + "/fld_input_" + std::to_string(index) + "_" + extension;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Queue.push_back(std::move(frame));
+		}
+		m_CondVar.notify_one();
+		return true;
+	}
+
+	/*
+	* Number of frames written so far.
+	*/
+	size_t dumped() const {
+		return m_nDumped.load();
+	}
+
+	/*
+	* Number of frames selected for dumping but dropped.
+	*/
+	size_t dropped() const {
+		return m_nDropped.load();
+	}
+
+private:
+	struct Frame {
+		std::vector<uint8_t> buffer;
+		std::string path;
+	};
+
+	// Token bucket refilled at "maxBytesPerSecond", holding at most one second of budget. Must be called with the lock held.
+	bool consumeBudget(const size_t size) {
+		if (!m_Config.maxBytesPerSecond) {
+			return true;
+		}
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		const double elapsed = std::chrono::duration_cast<std::chrono::duration<double >>(now - m_BudgetTime).count();
+		m_BudgetTime = now;
+		m_nBudget = std::min(m_nBudget + (elapsed * m_Config.maxBytesPerSecond), static_cast<double>(m_Config.maxBytesPerSecond));
+		if (m_nBudget < static_cast<double>(size)) {
+			return false;
+		}
+		m_nBudget -= static_cast<double>(size);
+		return true;
+	}
+
+	void run() {
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (m_bRunning || !m_Queue.empty()) {
+			if (m_Queue.empty()) {
+				m_CondVar.wait(lock, [this] { return !m_bRunning || !m_Queue.empty(); });
+				continue;
+			}
+			Frame frame = std::move(m_Queue.front());
+			m_Queue.pop_front();
+			lock.unlock();
+			FILE* file = fopen(frame.path.c_str(), "wb");
+			if (file) {
+				if (fwrite(frame.buffer.data(), 1, frame.buffer.size(), file) == frame.buffer.size()) {
+					m_nDumped.fetch_add(1);
+				}
+				fclose(file);
+			}
+			else {
+				FLD_SDK_PRINT_ERROR("Can't open %s", frame.path.c_str());
+			}
+			lock.lock();
+			m_Free.push_back(std::move(frame.buffer)); // Back to the pool
+		}
+	}
+
+	FldDumpConfig m_Config;
+	std::atomic<size_t> m_nFrames;
+	std::atomic<size_t> m_nDumped;
+	std::atomic<size_t> m_nDropped;
+	double m_nBudget;
+	std::chrono::steady_clock::time_point m_BudgetTime;
+	bool m_bRunning;
+	std::mutex m_Mutex;
+	std::condition_variable m_CondVar;
+	std::vector<std::vector<uint8_t> > m_Free;
+	std::deque<Frame> m_Queue;
+	std::thread m_Thread;
+};
+
+#endif /* _FACE_LIVENESS_SDK_SAMPLES_DUMP_UTILS_H_ */
@@ -0,0 +1,220 @@
+#if !defined(_FACE_LIVENESS_SDK_SAMPLES_LOG_UTILS_H_)
+#define _FACE_LIVENESS_SDK_SAMPLES_LOG_UTILS_H_
+
+#include <FLD-SDK-API-PUBLIC.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+using namespace FaceLiveness;
+
+/*
+* Log levels, same order as the engine's "debug_level" config entry.
+*/
+enum FLD_LOG_LEVEL {
+	FLD_LOG_LEVEL_VERBOSE,
+	FLD_LOG_LEVEL_INFO,
+	FLD_LOG_LEVEL_WARN,
+	FLD_LOG_LEVEL_ERROR,
+	FLD_LOG_LEVEL_FATAL,
+};
+
+/*
+* Asynchronous logger to use from hot paths (e.g. delivery callback) instead of the synchronous FLD_SDK_PRINT_* macros.
+* The level is checked before formatting, the formatted message is pushed to a lock-free bounded ring buffer and written
+* to the sink by a background thread. The callers never block: when the ring buffer is full the message is dropped and counted.
+* The writer thread sleeps while the ring buffer is empty and is only woken up by the first message pushed after that
+* (the only push which takes a lock). Messages longer than kMaxMessageSize are truncated.
+*/
+class FldAsyncLogger {
+public:
+	static const size_t kNumSlots = 1024; // Must be a power of 2
+	static const size_t kMaxMessageSize = 2048;
+
+	typedef std::function<void(const FLD_LOG_LEVEL level, const char* message)> Sink;
+
+	FldAsyncLogger(const FLD_LOG_LEVEL level = FLD_LOG_LEVEL_INFO)
+		: m_eLevel(level)
+		, m_pSlots(new Slot[kNumSlots])
+		, m_nEnqueuePos(0)
+		, m_nDequeuePos(0)
+		, m_nDropped(0)
+		, m_bRunning(true)
+		, m_bSleeping(false)
+		, m_Sink([](const FLD_LOG_LEVEL, const char* message) { fputs(message, stderr); fputc('\n', stderr); }) {
+		for (size_t i = 0; i < kNumSlots; ++i) {
+			m_pSlots[i].sequence.store(i);
+		}
+		m_Thread = std::thread(&FldAsyncLogger::run, this);
+	}
+
+	/*
+	* Writes the pending messages then stops the writer thread.
+	*/
+	virtual ~FldAsyncLogger() {
+		{
+			std::lock_guard<std::mutex> lock(m_WakeUpMutex);
+			m_bRunning.store(false);
+		}
+		m_WakeUpCondVar.notify_one();
+		m_Thread.join();
+		const size_t dropped = m_nDropped.load();
+		if (dropped) {
+			fprintf(stderr, "*[FLD_SDK WARN]: %zu log message(s) dropped\n", dropped);
+		}
+	}
+
+	/*
+	* Process-wide logger used by the FLD_ASYNC_PRINT_* macros.
+	*/
+	static FldAsyncLogger& instance() {
+		static FldAsyncLogger s_Logger;
+		return s_Logger;
+	}
+
+	/*
+	* Messages below this level are ignored without being formatted.
+	*/
+	void setLevel(const FLD_LOG_LEVEL level) {
+		m_eLevel.store(level, std::memory_order_relaxed);
+	}
+
+	inline bool isEnabled(const FLD_LOG_LEVEL level) const {
+		return level >= m_eLevel.load(std::memory_order_relaxed);
+	}
+
+	/*
+	* Replaces the sink (default: stderr). Could be called at any time from any thread, the sink itself is only
+	* called from the writer thread.
+	*/
+	void setSink(const Sink& sink) {
+		std::lock_guard<std::mutex> lock(m_SinkMutex);
+		m_Sink = sink;
+	}
+
+	/*
+	* Number of messages dropped because the ring buffer was full.
+	*/
+	size_t dropped() const {
+		return m_nDropped.load();
+	}
+
+	void log(const FLD_LOG_LEVEL level, const char* format, ...)
+#if defined(__GNUC__)
+		__attribute__((format(printf, 3, 4)))
+#endif
+	{
+		if (!isEnabled(level)) {
+			return;
+		}
+		// Claim a slot (Vyukov's bounded queue)
+		Slot* slot;
+		size_t pos = m_nEnqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			slot = &m_pSlots[pos & (kNumSlots - 1)];
+			const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+			if (diff == 0) {
+				if (m_nEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (diff < 0) {
+				m_nDropped.fetch_add(1, std::memory_order_relaxed); // Full
+				return;
+			}
+			else {
+				pos = m_nEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		va_list args;
+		va_start(args, format);
+		vsnprintf(slot->message, kMaxMessageSize, format, args);
+		va_end(args);
+		slot->level = level;
+		slot->sequence.store(pos + 1, std::memory_order_release);
+		// Wake up the writer if it's waiting for the queue to become non-empty, paired with the fence in run()
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_bSleeping.load(std::memory_order_relaxed) && m_bSleeping.exchange(false)) {
+			std::lock_guard<std::mutex> lock(m_WakeUpMutex);
+			m_WakeUpCondVar.notify_one();
+		}
+	}
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;
+		FLD_LOG_LEVEL level;
+		char message[kMaxMessageSize];
+	};
+
+	// Whether the next message is fully written, writer thread only
+	bool hasPending() const {
+		const Slot& slot = m_pSlots[m_nDequeuePos & (kNumSlots - 1)];
+		return slot.sequence.load(std::memory_order_acquire) == m_nDequeuePos + 1;
+	}
+
+	// Writes the pending messages, returns the number of messages written
+	size_t drain() {
+		std::lock_guard<std::mutex> lock(m_SinkMutex);
+		size_t count = 0;
+		while (hasPending()) {
+			Slot& slot = m_pSlots[m_nDequeuePos & (kNumSlots - 1)];
+			m_Sink(slot.level, slot.message);
+			slot.sequence.store(m_nDequeuePos + kNumSlots, std::memory_order_release);
+			++m_nDequeuePos;
+			++count;
+		}
+		return count;
+	}
+
+	void run() {
+		while (m_bRunning.load()) {
+			if (drain()) {
+				continue;
+			}
+			// Empty: announce we're going to sleep then check again, a message published after the fence sees the flag.
+			// A single wait (no predicate) then loop: the flag is set again before each wait, in case the wake-up came from
+			// a message published while an older slot was still being written.
+			m_bSleeping.store(true);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			{
+				std::unique_lock<std::mutex> lock(m_WakeUpMutex);
+				if (m_bRunning.load() && !hasPending()) {
+					m_WakeUpCondVar.wait(lock);
+				}
+			}
+			m_bSleeping.store(false);
+		}
+		drain();
+	}
+
+	std::atomic<FLD_LOG_LEVEL> m_eLevel;
+	std::unique_ptr<Slot[]> m_pSlots;
+	std::atomic<size_t> m_nEnqueuePos;
+	size_t m_nDequeuePos; // Writer thread only
+	std::atomic<size_t> m_nDropped;
+	std::atomic<bool> m_bRunning;
+	std::atomic<bool> m_bSleeping;
+	std::mutex m_WakeUpMutex;
+	std::condition_variable m_WakeUpCondVar;
+	std::mutex m_SinkMutex;
+	Sink m_Sink; // Guarded by m_SinkMutex
+	std::thread m_Thread;
+};
+
+// Same as the FLD_SDK_PRINT_* macros but asynchronous
+#define FLD_ASYNC_PRINT_VERBOSE(FMT, ...) FldAsyncLogger::instance().log(FLD_LOG_LEVEL_VERBOSE, "*[FLD_SDK VERBOSE]: " FMT, ##__VA_ARGS__)
+#define FLD_ASYNC_PRINT_INFO(FMT, ...) FldAsyncLogger::instance().log(FLD_LOG_LEVEL_INFO, "*[FLD_SDK INFO]: " FMT, ##__VA_ARGS__)
+#define FLD_ASYNC_PRINT_WARN(FMT, ...) FldAsyncLogger::instance().log(FLD_LOG_LEVEL_WARN, "**[FLD_SDK WARN]: function: \"%s()\" \nfile: \"%s\" \nline: \"%u\" \nmessage: " FMT, __FUNCTION__, __FILE__, __LINE__, ##__VA_ARGS__)
+#define FLD_ASYNC_PRINT_ERROR(FMT, ...) FldAsyncLogger::instance().log(FLD_LOG_LEVEL_ERROR, "***[FLD_SDK ERROR]: function: \"%s()\" \nfile: \"%s\" \nline: \"%u\" \nmessage: " FMT, __FUNCTION__, __FILE__, __LINE__, ##__VA_ARGS__)
+
+#endif /* _FACE_LIVENESS_SDK_SAMPLES_LOG_UTILS_H_ */
@@ -0,0 +1,445 @@
+#if !defined(_FACE_LIVENESS_SDK_SAMPLES_METRICS_UTILS_H_)
+#define _FACE_LIVENESS_SDK_SAMPLES_METRICS_UTILS_H_
+
+#include <FLD-SDK-API-PUBLIC.h>
+#include "fld_result_utils.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <memory>
+
+using namespace FaceLiveness;
+
+/*
+* Milliseconds elapsed since a time point
+*/
+static double fldElapsedMillis(const std::chrono::high_resolution_clock::time_point& start)
+{
+	return std::chrono::duration_cast<std::chrono::duration<double >>(std::chrono::high_resolution_clock::now() - start).count() * 1000.0;
+}
+
+/*
+* Latency samples (in milliseconds) with percentiles. Not thread-safe.
+*/
+struct FldLatencySamples {
+	std::vector<double> samples;
+
+	void reserve(const size_t count) {
+		samples.reserve(count);
+	}
+
+	void add(const double millis) {
+		samples.push_back(millis);
+	}
+
+	/*
+	* Builds a summary string: "count, min, avg, p50, p90, p99, max".
+	*/
+	std::string summary() const {
+		if (samples.empty()) {
+			return "no samples";
+		}
+		std::vector<double> sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (const double sample : sorted) {
+			sum += sample;
+		}
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "count=%zu, min=%.3f, avg=%.3f, p50=%.3f, p90=%.3f, p99=%.3f, max=%.3f millis",
+			sorted.size(),
+			sorted.front(),
+			sum / sorted.size(),
+			percentile(sorted, 0.50),
+			percentile(sorted, 0.90),
+			percentile(sorted, 0.99),
+			sorted.back()
+		);
+		return buffer;
+	}
+
+private:
+	static double percentile(const std::vector<double>& sorted, const double p) {
+		const size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+};
+
+/*
+* Engine metrics recorded by the application: counters, verdicts per "liveness_code" and a process() latency histogram.
+* The counters are sharded per thread: each recording thread is assigned one of kNumShards cache-line aligned shards
+* (round-robin, shared when there are more threads than shards) and only uses relaxed atomics on it, which means
+* recording is lock-free, could be called from the delivery callback and from any thread calling process(), and threads
+* don't contend on the same cache line. snapshot() sums the shards.
+*/
+class FldMetrics {
+public:
+	static const size_t kMaxVerdicts = 16;
+	static const size_t kMaxVerdictLength = 32;
+	static const size_t kNumLatencyBuckets = 13;
+	static const size_t kNumShards = 16; // Must be a power of 2
+
+	/*
+	* Snapshot of the metrics, cheap to take (no lock, a few atomic loads).
+	*/
+	struct Snapshot {
+		unsigned long long framesSubmitted = 0;
+		unsigned long long framesProcessed = 0;
+		unsigned long long framesFailed = 0;
+		unsigned long long facesDetected = 0;
+		unsigned long long queueDepth = 0;
+		size_t numVerdicts = 0;
+		char verdicts[kMaxVerdicts][kMaxVerdictLength];
+		unsigned long long verdictCounts[kMaxVerdicts];
+		unsigned long long latencyBuckets[kNumLatencyBuckets]; // Cumulative counts, same as Prometheus
+		unsigned long long latencyCount = 0;
+		double latencySumInMillis = 0.0;
+	};
+
+	FldMetrics() {
+		for (size_t i = 0; i < kMaxVerdicts; ++i) {
+			m_Verdicts[i].state.store(kVerdictFree);
+		}
+		for (size_t i = 0; i < kNumShards; ++i) {
+			Shard& shard = m_Shards[i];
+			shard.framesSubmitted.store(0);
+			shard.framesProcessed.store(0);
+			shard.framesFailed.store(0);
+			shard.facesDetected.store(0);
+			shard.latencySumInMicros.store(0);
+			for (size_t j = 0; j < kNumLatencyBuckets; ++j) {
+				shard.latencyBuckets[j].store(0);
+			}
+			for (size_t j = 0; j < kMaxVerdicts; ++j) {
+				shard.verdictCounts[j].store(0);
+			}
+		}
+	}
+
+	/*
+	* Upper bounds (in milliseconds) for the latency histogram buckets, the last one is +Inf.
+	*/
+	static double latencyBucketBound(const size_t index) {
+		static const double kBounds[kNumLatencyBuckets - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+		return index < (kNumLatencyBuckets - 1) ? kBounds[index] : -1.0;
+	}
+
+	/*
+	* To be called after each process() call.
+	* @param latencyInMillis Time spent in process().
+	*/
+	void onSubmitted(const double latencyInMillis) {
+		Shard& shard = threadShard();
+		shard.framesSubmitted.fetch_add(1, std::memory_order_relaxed);
+		size_t bucket = 0;
+		while (bucket < (kNumLatencyBuckets - 1) && latencyInMillis > latencyBucketBound(bucket)) {
+			++bucket;
+		}
+		shard.latencyBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		shard.latencySumInMicros.fetch_add(static_cast<unsigned long long>(latencyInMillis * 1000.0), std::memory_order_relaxed);
+	}
+
+	/*
+	* To be called for each result: from the delivery callback in parallel mode or after process() in sequential mode.
+	*/
+	void onResult(const FldSdkResult* result) {
+		Shard& shard = threadShard();
+		shard.framesProcessed.fetch_add(1, std::memory_order_relaxed);
+		if (!result->isOK()) {
+			shard.framesFailed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		shard.facesDetected.fetch_add(result->numFaces(), std::memory_order_relaxed);
+		fldForEachLivenessCode(result->json(), [this, &shard](const char* code, const size_t length) -> bool {
+			addVerdict(shard, code, length);
+			return true;
+		});
+	}
+
+	Snapshot snapshot() const {
+		Snapshot snapshot;
+		unsigned long long latencySumInMicros = 0;
+		for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+			snapshot.latencyBuckets[i] = 0;
+		}
+		for (size_t i = 0; i < kNumShards; ++i) {
+			const Shard& shard = m_Shards[i];
+			snapshot.framesSubmitted += shard.framesSubmitted.load(std::memory_order_relaxed);
+			snapshot.framesProcessed += shard.framesProcessed.load(std::memory_order_relaxed);
+			snapshot.framesFailed += shard.framesFailed.load(std::memory_order_relaxed);
+			snapshot.facesDetected += shard.facesDetected.load(std::memory_order_relaxed);
+			latencySumInMicros += shard.latencySumInMicros.load(std::memory_order_relaxed);
+			for (size_t j = 0; j < kNumLatencyBuckets; ++j) {
+				snapshot.latencyBuckets[j] += shard.latencyBuckets[j].load(std::memory_order_relaxed);
+			}
+		}
+		snapshot.queueDepth = snapshot.framesSubmitted > snapshot.framesProcessed ? (snapshot.framesSubmitted - snapshot.framesProcessed) : 0;
+		for (size_t i = 0; i < kMaxVerdicts; ++i) {
+			if (m_Verdicts[i].state.load(std::memory_order_acquire) == kVerdictReady) {
+				unsigned long long count = 0;
+				for (size_t j = 0; j < kNumShards; ++j) {
+					count += m_Shards[j].verdictCounts[i].load(std::memory_order_relaxed);
+				}
+				memcpy(snapshot.verdicts[snapshot.numVerdicts], m_Verdicts[i].label, kMaxVerdictLength);
+				snapshot.verdictCounts[snapshot.numVerdicts++] = count;
+			}
+		}
+		unsigned long long cumulative = 0;
+		for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+			cumulative += snapshot.latencyBuckets[i];
+			snapshot.latencyBuckets[i] = cumulative;
+		}
+		snapshot.latencyCount = cumulative;
+		snapshot.latencySumInMillis = latencySumInMicros / 1000.0;
+		return snapshot;
+	}
+
+	/*
+	* Exports the metrics using Prometheus text format.
+	*/
+	std::string prometheus() const {
+		const Snapshot s = snapshot();
+		std::string text;
+		char line[256];
+		snprintf(line, sizeof(line),
+			"# TYPE fld_frames_submitted_total counter\nfld_frames_submitted_total %llu\n"
+			"# TYPE fld_frames_processed_total counter\nfld_frames_processed_total %llu\n"
+			"# TYPE fld_frames_failed_total counter\nfld_frames_failed_total %llu\n",
+			s.framesSubmitted, s.framesProcessed, s.framesFailed);
+		text += line;
+		snprintf(line, sizeof(line),
+			"# TYPE fld_faces_detected_total counter\nfld_faces_detected_total %llu\n"
+			"# TYPE fld_queue_depth gauge\nfld_queue_depth %llu\n"
+			"# TYPE fld_verdicts_total counter\n",
+			s.facesDetected, s.queueDepth);
+		text += line;
+		for (size_t i = 0; i < s.numVerdicts; ++i) {
+			snprintf(line, sizeof(line), "fld_verdicts_total{liveness_code=\"%s\"} %llu\n", s.verdicts[i], s.verdictCounts[i]);
+			text += line;
+		}
+		text += "# TYPE fld_process_latency_milliseconds histogram\n";
+		for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+			const double bound = latencyBucketBound(i);
+			if (bound < 0.0) {
+				snprintf(line, sizeof(line), "fld_process_latency_milliseconds_bucket{le=\"+Inf\"} %llu\n", s.latencyBuckets[i]);
+			}
+			else {
+				snprintf(line, sizeof(line), "fld_process_latency_milliseconds_bucket{le=\"%g\"} %llu\n", bound, s.latencyBuckets[i]);
+			}
+			text += line;
+		}
+		snprintf(line, sizeof(line), "fld_process_latency_milliseconds_sum %.3f\nfld_process_latency_milliseconds_count %llu\n", s.latencySumInMillis, s.latencyCount);
+		text += line;
+		return text;
+	}
+
+	/*
+	* Writes the metrics to a file using Prometheus text format (e.g. for node_exporter's textfile collector).
+	* @returns true if succeed, false otherwise
+	*/
+	bool writePrometheus(const std::string& path) const {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) {
+			FLD_SDK_PRINT_ERROR("Can't open %s", path.c_str());
+			return false;
+		}
+		const std::string text = prometheus();
+		const bool ok = (fwrite(text.data(), 1, text.size(), file) == text.size());
+		fclose(file);
+		return ok;
+	}
+
+private:
+	struct alignas(64) Shard {
+		std::atomic<unsigned long long> framesSubmitted;
+		std::atomic<unsigned long long> framesProcessed;
+		std::atomic<unsigned long long> framesFailed;
+		std::atomic<unsigned long long> facesDetected;
+		std::atomic<unsigned long long> latencySumInMicros;
+		std::atomic<unsigned long long> latencyBuckets[kNumLatencyBuckets];
+		std::atomic<unsigned long long> verdictCounts[kMaxVerdicts]; // Indexed like m_Verdicts
+	};
+
+	// Shard of the calling thread, assigned round-robin on first use
+	Shard& threadShard() {
+		static std::atomic<size_t> s_nNextShard(0);
+		thread_local const size_t t_nShard = s_nNextShard.fetch_add(1, std::memory_order_relaxed) & (kNumShards - 1);
+		return m_Shards[t_nShard];
+	}
+
+	void addVerdict(Shard& shard, const char* label, size_t length) {
+		length = std::min(length, kMaxVerdictLength - 1);
+		for (size_t i = 0; i < kMaxVerdicts; ++i) {
+			Verdict& verdict = m_Verdicts[i];
+			int state = verdict.state.load(std::memory_order_acquire);
+			if (state == kVerdictFree && verdict.state.compare_exchange_strong(state, kVerdictWriting, std::memory_order_acquire)) {
+				memcpy(verdict.label, label, length);
+				verdict.label[length] = '\0';
+				verdict.state.store(kVerdictReady, std::memory_order_release);
+				state = kVerdictReady;
+			}
+			while (state == kVerdictWriting) { // Another thread is claiming this slot
+				state = verdict.state.load(std::memory_order_acquire);
+			}
+			if (strncmp(verdict.label, label, length) == 0 && verdict.label[length] == '\0') {
+				shard.verdictCounts[i].fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+		// More than kMaxVerdicts distinct codes: not counted
+	}
+
+	enum { kVerdictFree, kVerdictWriting, kVerdictReady };
+	struct Verdict {
+		std::atomic<int> state;
+		char label[kMaxVerdictLength];
+	};
+
+	Shard m_Shards[kNumShards];
+	Verdict m_Verdicts[kMaxVerdicts]; // Written once per distinct code, read-mostly
+};
+
+/*
+* Records trace events into a lock-free ring buffer and writes them using Chrome trace-event JSON format.
+* The file could be opened using chrome://tracing or https://ui.perfetto.dev.
+* When the ring buffer is full the oldest events are overwritten. A writer claims its slot with a CAS from an older lap's
+* value: if the slot is being written by another thread (or already holds a later lap's event) the event is dropped
+* and counted instead of being torn.
+*/
+class FldTracer {
+public:
+	/*
+	* @param capacity Maximum number of events kept in the ring buffer.
+	*/
+	FldTracer(const size_t capacity = 65536)
+		: m_nCapacity(capacity ? capacity : 1)
+		, m_pEvents(new Event[m_nCapacity])
+		, m_Epoch(std::chrono::high_resolution_clock::now()) {
+		m_nNext.store(0);
+		m_nDropped.store(0);
+		for (size_t i = 0; i < m_nCapacity; ++i) {
+			m_pEvents[i].sequence.store(0);
+		}
+	}
+
+	/*
+	* Records a complete event (begin + duration) on the calling thread.
+	* @param name Event name, must be a literal string (the pointer is stored, not the content).
+	* @param start When the event started.
+	* @param tag Frame tag (e.g. frame index), -1 if none.
+	*/
+	void complete(const char* name, const std::chrono::high_resolution_clock::time_point& start, const long long tag = -1) {
+		const std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+		record(name, 'X', micros(start), micros(end) - micros(start), tag);
+	}
+
+	/*
+	* Records an instant event on the calling thread.
+	* @param name Event name, must be a literal string (the pointer is stored, not the content).
+	* @param tag Frame tag (e.g. frame index), -1 if none.
+	*/
+	void instant(const char* name, const long long tag = -1) {
+		record(name, 'i', micros(std::chrono::high_resolution_clock::now()), 0, tag);
+	}
+
+	/*
+	* Number of events dropped because their slot was still being written by another thread.
+	*/
+	unsigned long long dropped() const {
+		return m_nDropped.load(std::memory_order_relaxed);
+	}
+
+	/*
+	* Writes the recorded events to a file. Should be called when no thread is recording.
+	* @returns true if succeed, false otherwise
+	*/
+	bool write(const std::string& path) const {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) {
+			FLD_SDK_PRINT_ERROR("Can't open %s", path.c_str());
+			return false;
+		}
+		const unsigned long long next = m_nNext.load(std::memory_order_acquire);
+		const unsigned long long first = next > m_nCapacity ? (next - m_nCapacity) : 0;
+		bool comma = false;
+		fputs("{\"traceEvents\":[", file);
+		for (unsigned long long index = first; index < next; ++index) {
+			const Event& event = m_pEvents[index % m_nCapacity];
+			if (event.sequence.load(std::memory_order_acquire) != index + 1) {
+				continue; // Not fully written or already overwritten
+			}
+			fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u",
+				comma ? "," : "", event.name, event.phase, event.timestamp, event.threadId);
+			if (event.phase == 'X') {
+				fprintf(file, ",\"dur\":%lld", event.duration);
+			}
+			else {
+				fputs(",\"s\":\"t\"", file);
+			}
+			if (event.tag >= 0) {
+				fprintf(file, ",\"args\":{\"frame\":%lld}", event.tag);
+			}
+			fputs("}", file);
+			comma = true;
+		}
+		fputs("\n]}\n", file);
+		fclose(file);
+		return true;
+	}
+
+private:
+	struct Event {
+		std::atomic<unsigned long long> sequence; // Index + 1 once written, kWriting while being written, 0 if never written
+		const char* name;
+		char phase;
+		unsigned threadId;
+		long long timestamp;
+		long long duration;
+		long long tag;
+	};
+
+	long long micros(const std::chrono::high_resolution_clock::time_point& time) const {
+		return std::chrono::duration_cast<std::chrono::microseconds>(time - m_Epoch).count();
+	}
+
+	static unsigned threadId() {
+		// Small thread ids, easier to read than the native ones in the trace viewer
+		static std::atomic<unsigned> s_nNextThreadId(1);
+		static thread_local unsigned s_nThreadId = s_nNextThreadId.fetch_add(1);
+		return s_nThreadId;
+	}
+
+	void record(const char* name, const char phase, const long long timestamp, const long long duration, const long long tag) {
+		const unsigned long long index = m_nNext.fetch_add(1, std::memory_order_relaxed);
+		Event& event = m_pEvents[index % m_nCapacity];
+		// Claim the slot: only possible if it holds an older lap's event (or nothing) and no other thread is writing it
+		unsigned long long sequence = event.sequence.load(std::memory_order_relaxed);
+		do {
+			if (sequence == kWriting || sequence > index) {
+				m_nDropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		} while (!event.sequence.compare_exchange_weak(sequence, kWriting, std::memory_order_acquire, std::memory_order_relaxed));
+		event.name = name;
+		event.phase = phase;
+		event.threadId = threadId();
+		event.timestamp = timestamp;
+		event.duration = duration;
+		event.tag = tag;
+		event.sequence.store(index + 1, std::memory_order_release);
+	}
+
+	static const unsigned long long kWriting = ~0ULL;
+
+	const size_t m_nCapacity;
+	std::unique_ptr<Event[]> m_pEvents;
+	std::atomic<unsigned long long> m_nNext;
+	std::atomic<unsigned long long> m_nDropped;
+	const std::chrono::high_resolution_clock::time_point m_Epoch;
+};
+
+#endif /* _FACE_LIVENESS_SDK_SAMPLES_METRICS_UTILS_H_ */
@@ -0,0 +1,329 @@
+#if !defined(_FACE_LIVENESS_SDK_SAMPLES_PARALLEL_UTILS_H_)
+#define _FACE_LIVENESS_SDK_SAMPLES_PARALLEL_UTILS_H_
+
+#include <FLD-SDK-API-PUBLIC.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#if defined(__linux__)
+#	include <sys/eventfd.h>
+#	include <unistd.h>
+#endif /* __linux__ */
+
+using namespace FaceLiveness;
+
+/*
+* Tracks the frames submitted in parallel mode until they are delivered to the callback.
+* Used to know exactly when the pipeline is empty (graceful shutdown, benchmarks) instead of waiting for an arbitrary delay.
+*/
+class FldDeliveryTracker {
+public:
+	FldDeliveryTracker() : m_nSubmitted(0), m_nDelivered(0) { }
+
+	/*
+	* To be called before each FldSdkEngine::process() call. Must be called before and not after because
+	* the result could be delivered before process() returns.
+	*/
+	void onSubmitted() {
+		m_nSubmitted.fetch_add(1);
+	}
+
+	/*
+	* To be called when FldSdkEngine::process() failed after onSubmitted(): nothing will be delivered.
+	*/
+	void onSubmitFailed() {
+		onDelivered();
+	}
+
+	/*
+	* To be called from FldSdkParallelDeliveryCallback::onNewResult().
+	* @returns the number of results delivered so far, including this one
+	*/
+	size_t onDelivered() {
+		const size_t delivered = m_nDelivered.fetch_add(1) + 1;
+		if (delivered >= m_nSubmitted.load()) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_CondVar.notify_all();
+		}
+		return delivered;
+	}
+
+	/*
+	* Number of frames submitted but not delivered yet.
+	*/
+	size_t pending() const {
+		const size_t delivered = m_nDelivered.load();
+		const size_t submitted = m_nSubmitted.load();
+		return submitted > delivered ? (submitted - delivered) : 0;
+	}
+
+	/*
+	* Number of results delivered so far.
+	*/
+	size_t delivered() const {
+		return m_nDelivered.load();
+	}
+
+	/*
+	* Blocks until every submitted frame has been delivered or the timeout expires.
+	* @param timeout Maximum time to wait for.
+	* @returns the number of frames still pending, zero if the pipeline is empty
+	*/
+	size_t flush(const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_CondVar.wait_for(lock, timeout, [this] { return pending() == 0; });
+		return pending();
+	}
+
+private:
+	std::atomic<size_t> m_nSubmitted;
+	std::atomic<size_t> m_nDelivered;
+	std::mutex m_Mutex;
+	std::condition_variable m_CondVar;
+};
+
+/*
+* Batched version of FldSdkParallelDeliveryCallback, see FldBatchingDeliveryCallback.
+*/
+struct FldSdkParallelBatchDeliveryCallback
+{
+protected:
+	FldSdkParallelBatchDeliveryCallback() { }
+public:
+	virtual ~FldSdkParallelBatchDeliveryCallback() { }
+	/*! Notification function to override in order to receive the results completed since the last call.
+	The pointers are only valid during the call. */
+	virtual void onNewResults(const FldSdkResult* const* results, const size_t count) = 0;
+};
+
+/*
+* Parallel delivery callback to pass to FldSdkEngine::init() to receive the results in batches:
+* the results completed since the last delivery are forwarded to a FldSdkParallelBatchDeliveryCallback using a single call,
+* at most "maxDelay" after the oldest one completed or as soon as "maxBatchSize" results are pending.
+* Amortizes the per-result cost on the application side (locking, queueing, JNI or Python transition...).
+*/
+class FldBatchingDeliveryCallback : public FldSdkParallelDeliveryCallback {
+public:
+	FldBatchingDeliveryCallback(FldSdkParallelBatchDeliveryCallback* batchCallback, const std::chrono::milliseconds& maxDelay, const size_t maxBatchSize = 64)
+		: m_pBatchCallback(batchCallback)
+		, m_MaxDelay(maxDelay)
+		, m_nMaxBatchSize(maxBatchSize ? maxBatchSize : 1)
+		, m_bRunning(true) {
+		FLD_SDK_ASSERT(m_pBatchCallback != nullptr);
+		m_Thread = std::thread(&FldBatchingDeliveryCallback::run, this);
+	}
+
+	/*
+	* Delivers the pending results then stops the delivery thread. Must be destroyed after FldSdkEngine::deInit().
+	*/
+	virtual ~FldBatchingDeliveryCallback() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_bRunning = false;
+		}
+		m_CondVar.notify_one();
+		m_Thread.join();
+	}
+
+	virtual void onNewResult(const FldSdkResult* newResult) const override {
+		bool wakeUp;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			const bool first = m_Pending.empty();
+			if (first) {
+				m_OldestTime = std::chrono::steady_clock::now();
+			}
+			m_Pending.push_back(*newResult);
+			wakeUp = first || (m_Pending.size() >= m_nMaxBatchSize); // Start the delay or deliver a full batch
+		}
+		if (wakeUp) {
+			m_CondVar.notify_one();
+		}
+	}
+
+private:
+	void run() {
+		std::vector<FldSdkResult> batch;
+		std::vector<const FldSdkResult*> pointers;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (m_bRunning || !m_Pending.empty()) {
+			if (m_Pending.empty()) {
+				m_CondVar.wait(lock, [this] { return !m_bRunning || !m_Pending.empty(); });
+				continue;
+			}
+			// Wait until the batch is full or the oldest result reaches the maximum delay
+			m_CondVar.wait_until(lock, m_OldestTime + m_MaxDelay, [this] { return !m_bRunning || m_Pending.size() >= m_nMaxBatchSize; });
+			batch.swap(m_Pending);
+			lock.unlock();
+			pointers.resize(batch.size());
+			for (size_t i = 0; i < batch.size(); ++i) {
+				pointers[i] = &batch[i];
+			}
+			m_pBatchCallback->onNewResults(pointers.data(), pointers.size());
+			batch.clear();
+			lock.lock();
+		}
+	}
+
+	FldSdkParallelBatchDeliveryCallback* m_pBatchCallback;
+	const std::chrono::milliseconds m_MaxDelay;
+	const size_t m_nMaxBatchSize;
+	bool m_bRunning;
+	mutable std::mutex m_Mutex;
+	mutable std::condition_variable m_CondVar;
+	mutable std::vector<FldSdkResult> m_Pending;
+	mutable std::chrono::steady_clock::time_point m_OldestTime;
+	std::thread m_Thread;
+};
+
+/*
+* Parallel delivery callback to pass to FldSdkEngine::init() for applications based on an event loop (epoll, asyncio...)
+* which want to poll the results instead of having them pushed from an engine thread.
+* The results are queued using a lock-free MPSC (multiple producers, single consumer) queue and, on Linux, fd() returns an
+* eventfd which becomes readable when results are pending.
+* tryPopResult() and popResults() must be called from a single thread (the consumer).
+*/
+class FldPollingDeliveryCallback : public FldSdkParallelDeliveryCallback {
+public:
+	FldPollingDeliveryCallback() : m_pTail(new Node()), m_nFd(-1) {
+		m_pHead.store(m_pTail);
+#if defined(__linux__)
+		if ((m_nFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+			FLD_SDK_PRINT_ERROR("eventfd failed");
+		}
+#endif /* __linux__ */
+	}
+
+	/*
+	* Must be destroyed after FldSdkEngine::deInit().
+	*/
+	virtual ~FldPollingDeliveryCallback() {
+		Node* node = m_pTail;
+		while (node) {
+			Node* next = node->next.load();
+			delete node;
+			node = next;
+		}
+#if defined(__linux__)
+		if (m_nFd >= 0) {
+			close(m_nFd);
+		}
+#endif /* __linux__ */
+	}
+
+	virtual void onNewResult(const FldSdkResult* newResult) const override {
+		Node* node = new Node(*newResult);
+		Node* previous = m_pHead.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+		signal();
+	}
+
+	/*
+	* File descriptor readable when results are pending, to be used with epoll/select/asyncio's add_reader.
+	* Only available on Linux, -1 otherwise.
+	*/
+	int fd() const {
+		return m_nFd;
+	}
+
+	/*
+	* Pops the oldest pending result, if any.
+	* @returns true if a result was popped, false if the queue is empty
+	*/
+	bool tryPopResult(FldSdkResult& result) {
+		return popResults(&result, 1) == 1;
+	}
+
+	/*
+	* Pops up to "max" pending results, oldest first.
+	* @returns the number of results copied to "results"
+	*/
+	size_t popResults(FldSdkResult* results, const size_t max) {
+		clear(); // Before popping: the results queued after this point signal again
+		size_t count = 0;
+		while (count < max) {
+			Node* next = m_pTail->next.load(std::memory_order_acquire);
+			if (!next) {
+				return count;
+			}
+			results[count++] = next->result;
+			delete m_pTail;
+			m_pTail = next; // "next" becomes the stub, its result was consumed
+		}
+		if (m_pTail->next.load(std::memory_order_acquire)) {
+			signal(); // Results left in the queue: keep the fd readable
+		}
+		return count;
+	}
+
+private:
+	struct Node {
+		Node() : next(nullptr) { }
+		Node(const FldSdkResult& result_) : next(nullptr), result(result_) { }
+		std::atomic<Node*> next;
+		FldSdkResult result;
+	};
+
+	void signal() const {
+#if defined(__linux__)
+		if (m_nFd >= 0) {
+			const uint64_t one = 1;
+			if (write(m_nFd, &one, sizeof(one)) != sizeof(one)) {
+				// EAGAIN only if the counter overflows, the fd is already readable
+			}
+		}
+#endif /* __linux__ */
+	}
+
+	void clear() {
+#if defined(__linux__)
+		if (m_nFd >= 0) {
+			uint64_t value;
+			if (read(m_nFd, &value, sizeof(value)) != sizeof(value)) {
+				// EAGAIN: nothing to clear
+			}
+		}
+#endif /* __linux__ */
+	}
+
+	mutable std::atomic<Node*> m_pHead; // Producers side
+	Node* m_pTail; // Consumer side, always a stub node whose result was already consumed
+	int m_nFd;
+};
+
+/*
+* What to do with the frames still in the pipeline when the engine is deinitialized.
+*/
+enum FLD_DRAIN_POLICY {
+	/*! Wait until all the submitted frames are delivered (up to a timeout) */
+	FLD_DRAIN_POLICY_WAIT,
+	/*! Deinitialize at once without waiting for the pending frames. Nothing is discarded on the host side: the engine
+	may still deliver (some of) them to the callback while deInit() runs, the callback must stay valid until it returns */
+	FLD_DRAIN_POLICY_DISCARD,
+};
+
+/*
+* Deinitializes the engine after draining the parallel pipeline according to the policy.
+* The frames still pending when deInit() is called (policy FLD_DRAIN_POLICY_DISCARD or timeout) may be delivered
+* to the callback while deInit() runs or never delivered at all.
+* @param tracker The delivery tracker, null in sequential mode.
+* @param policy Drain policy.
+* @param timeout Maximum time to wait for when the policy is FLD_DRAIN_POLICY_WAIT.
+* @returns the result of FldSdkEngine::deInit()
+*/
+static FldSdkResult fldDeInit(FldDeliveryTracker* tracker, const FLD_DRAIN_POLICY policy, const std::chrono::milliseconds& timeout)
+{
+	if (tracker) {
+		const size_t pending = (policy == FLD_DRAIN_POLICY_WAIT) ? tracker->flush(timeout) : tracker->pending();
+		if (pending) {
+			FLD_SDK_PRINT_WARN("Deinitializing with %zu pending frame(s), they may still be delivered during deInit()", pending);
+		}
+	}
+	return FldSdkEngine::deInit();
+}
+
+#endif /* _FACE_LIVENESS_SDK_SAMPLES_PARALLEL_UTILS_H_ */
@@ -0,0 +1,35 @@
+#if !defined(_FACE_LIVENESS_SDK_SAMPLES_RESULT_UTILS_H_)
+#define _FACE_LIVENESS_SDK_SAMPLES_RESULT_UTILS_H_
+
+#include <FLD-SDK-API-PUBLIC.h>
+#include <string.h>
+
+using namespace FaceLiveness;
+
+/*
+* Walks the "liveness_code" values (e.g. "s_spoof", "s_deepfake") of a result's JSON without parsing it nor allocating.
+* @param json The JSON string, could be null.
+* @param callback Called for each value with its first character and length (the value isn't null-terminated):
+* bool(const char* code, size_t length). Return false to stop.
+*/
+template <typename Callback>
+static void fldForEachLivenessCode(const char* json, Callback callback)
+{
+	static const char kKey[] = "\"liveness_code\"";
+	while (json && (json = strstr(json, kKey)) != nullptr) {
+		json += sizeof(kKey) - 1;
+		while (*json == ' ' || *json == ':') {
+			++json;
+		}
+		if (*json != '"') {
+			continue;
+		}
+		const char* end = strchr(++json, '"');
+		if (!end || !callback(json, static_cast<size_t>(end - json))) {
+			return;
+		}
+		json = end + 1;
+	}
+}
+
+#endif /* _FACE_LIVENESS_SDK_SAMPLES_RESULT_UTILS_H_ */
@@ -0,0 +1,423 @@
+#if !defined(_FACE_LIVENESS_SDK_SAMPLES_RUNTIME_UTILS_H_)
+#define _FACE_LIVENESS_SDK_SAMPLES_RUNTIME_UTILS_H_
+
+#include <FLD-SDK-API-PUBLIC.h>
+#include <string>
+#include <stdlib.h>
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#if defined(__linux__)
+#	include <sched.h>
+#endif /* __linux__ */
+
+using namespace FaceLiveness;
+
+/*
+* Threading configuration for the engine.
+* "num_threads" is the size of the engine's own pool (pre-processing, per-face loops) and each "*_tf_num_threads" is
+* the size of the Tensorflow pool created for the model. Setting -1 everywhere sizes each of these pools to the number of cores,
+* which means up to #5 times more runnable threads than cores. Use fldBuildThreadingConfig() to derive all values
+* from a single CPU budget instead.
+*/
+struct FldThreadingConfig {
+	int numThreads = -1;
+	int detectTfNumThreads = -1;
+	int livenessTfNumThreads = -1;
+	int deepfakeTfNumThreads = -1;
+	int disguiseTfNumThreads = -1;
+
+	/*
+	* Builds the JSON entries to append to the configuration, each entry is prefixed with a comma.
+	*/
+	std::string toJson() const {
+		return std::string(",\"num_threads\": ") + std::to_string(numThreads)
+			+ std::string(",\"detect_tf_num_threads\": ") + std::to_string(detectTfNumThreads)
+			+ std::string(",\"liveness_tf_num_threads\": ") + std::to_string(livenessTfNumThreads)
+			+ std::string(",\"deepfake_tf_num_threads\": ") + std::to_string(deepfakeTfNumThreads)
+			+ std::string(",\"disguise_tf_num_threads\": ") + std::to_string(disguiseTfNumThreads);
+	}
+};
+
+/*
+* CPU limit enforced by the cgroup (v2 "cpu.max" or v1 "cpu.cfs_quota_us" / "cpu.cfs_period_us"), rounded up.
+* This is the limit set by Docker's "--cpus" or the Kubernetes CPU limit.
+* @returns the number of CPUs allowed by the quota, zero if there is no quota (or not on Linux)
+*/
+static size_t fldCgroupCpuQuota()
+{
+#if defined(__linux__)
+	long long quota = -1, period = 0;
+	std::ifstream v2("/sys/fs/cgroup/cpu.max");
+	if (v2.is_open()) {
+		std::string max;
+		if ((v2 >> max >> period) && max != "max") {
+			quota = std::atoll(max.c_str());
+		}
+	}
+	else {
+		static const char* v1Folders[] = { "/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct" };
+		for (const char* folder : v1Folders) {
+			std::ifstream quotaFile(std::string(folder) + std::string("/cpu.cfs_quota_us"));
+			std::ifstream periodFile(std::string(folder) + std::string("/cpu.cfs_period_us"));
+			if ((quotaFile >> quota) && (periodFile >> period)) {
+				break;
+			}
+			quota = -1;
+		}
+	}
+	if (quota > 0 && period > 0) {
+		return static_cast<size_t>((quota + period - 1) / period);
+	}
+#endif /* __linux__ */
+	return 0;
+}
+
+/*
+* Number of CPUs available to the process: the smallest of the online CPUs, the CPUs in the affinity mask
+* (sched_getaffinity, e.g. taskset or Kubernetes static CPU manager) and the cgroup quota.
+* Use this value instead of -1 for the "*num_threads" entries: the engine sizes its pools from the host core count
+* which means heavy throttling in containers with a CPU quota.
+* @param verbose Whether to log how the value was resolved.
+* @returns the number of CPUs, at least 1
+*/
+static size_t fldCpuCount(const bool verbose = false)
+{
+	const unsigned int online = std::thread::hardware_concurrency();
+	size_t count = online > 0 ? static_cast<size_t>(online) : 1;
+	size_t affinity = 0;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		affinity = static_cast<size_t>(CPU_COUNT(&set));
+		if (affinity > 0) {
+			count = std::min(count, affinity);
+		}
+	}
+#endif /* __linux__ */
+	const size_t quota = fldCgroupCpuQuota();
+	if (quota > 0) {
+		count = std::min(count, quota);
+	}
+	if (verbose) {
+		FLD_SDK_PRINT_INFO("Resolved CPU count: %zu (online: %u, affinity: %zu, cgroup quota: %zu)", count, online, affinity, quota);
+	}
+	return count;
+}
+
+/*
+* Derives the pool sizes from a single CPU budget instead of the host core count. The per-model values are used as
+* concurrency caps so that the model threads running at the same time don't exceed the budget:
+*  - Sequential mode: the models run one after the other, each one may use the whole budget.
+*  - Parallel mode: the detection of the next frame overlaps with the liveness/deepfake/disguise checks
+*	on the current frame. The detector gets half the budget and the classifiers (which run one after the
+*	other on each face) share the other half.
+* The engine's own pool ("num_threads") is sized to the whole budget in both modes. Its tasks may overlap with
+* the models' in parallel mode, so up to twice the budget may be runnable there (vs up to #5 times the core count with -1).
+* @param cpuBudget Number of CPUs to use. Zero means all the CPUs available to the process (see fldCpuCount()).
+* @param parallelMode Whether the engine is initialized with a parallel delivery callback.
+* @returns the threading configuration
+*/
+static FldThreadingConfig fldBuildThreadingConfig(size_t cpuBudget, const bool parallelMode)
+{
+	if (!cpuBudget) {
+		cpuBudget = fldCpuCount(true);
+	}
+	const int budget = static_cast<int>(cpuBudget);
+	const int detectCap = parallelMode ? std::max(1, (budget + 1) >> 1) : budget;
+	const int classifierCap = parallelMode ? std::max(1, budget >> 1) : budget;
+
+	FldThreadingConfig config;
+	config.numThreads = budget;
+	config.detectTfNumThreads = detectCap;
+	config.livenessTfNumThreads = classifierCap;
+	config.deepfakeTfNumThreads = classifierCap;
+	config.disguiseTfNumThreads = classifierCap;
+	return config;
+}
+
+/*
+* Parses a CPU list using the same format as taskset/cgroup files (e.g. "0-3,8,10-11").
+* @param list The CPU list.
+* @param cpus The CPU indices, sorted and without duplicates.
+* @returns true if succeed, false otherwise
+*/
+static bool fldParseCpuList(const std::string& list, std::vector<int>& cpus)
+{
+#if defined(__linux__)
+	static const long kMaxCpus = CPU_SETSIZE;
+#else
+	static const long kMaxCpus = 1024;
+#endif /* __linux__ */
+	cpus.clear();
+	size_t start = 0;
+	while (start < list.size()) {
+		size_t end = list.find(',', start);
+		if (end == std::string::npos) {
+			end = list.size();
+		}
+		const std::string range = list.substr(start, end - start);
+		start = end + 1;
+		if (range.empty() || range == "\n") {
+			continue;
+		}
+		const char* str = range.c_str();
+		char* next = nullptr;
+		const long first = (*str >= '0' && *str <= '9') ? strtol(str, &next, 10) : -1;
+		long last = first;
+		if (first >= 0 && *next == '-') {
+			str = next + 1;
+			last = (*str >= '0' && *str <= '9') ? strtol(str, &next, 10) : -1;
+		}
+		if (first < 0 || last < first || last >= kMaxCpus || (*next != '\0' && *next != '\n')) {
+			FLD_SDK_PRINT_ERROR("Invalid CPU range: %s", range.c_str());
+			cpus.clear();
+			return false;
+		}
+		for (long cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(static_cast<int>(cpu));
+		}
+	}
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return !cpus.empty();
+}
+
+/*
+* CPUs in the affinity mask of the calling thread (sched_getaffinity, e.g. taskset or Kubernetes static CPU manager).
+* Only available on Linux.
+* @param cpus The logical CPUs, sorted.
+* @returns true if succeed, false otherwise
+*/
+static bool fldAffinityCpus(std::vector<int>& cpus)
+{
+	cpus.clear();
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+		FLD_SDK_PRINT_ERROR("sched_getaffinity failed");
+		return false;
+	}
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &set)) {
+			cpus.push_back(cpu);
+		}
+	}
+	return !cpus.empty();
+#else
+	return false;
+#endif /* __linux__ */
+}
+
+/*
+* Filters out the hyperthread siblings: only one logical CPU per physical core is kept, the first sibling
+* which is part of the candidates.
+* Only available on Linux, the list is returned unchanged on other platforms.
+* @param cpus The logical CPUs to filter. If empty, the CPUs in the affinity mask of the calling thread are used.
+* @returns the logical CPUs mapped to distinct physical cores, empty on error
+*/
+static std::vector<int> fldPhysicalCores(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+	std::vector<int> candidates = cpus;
+	if (candidates.empty() && !fldAffinityCpus(candidates)) {
+		return candidates;
+	}
+	std::sort(candidates.begin(), candidates.end());
+	std::vector<int> physical;
+	for (const int cpu : candidates) {
+		std::ifstream siblings(std::string("/sys/devices/system/cpu/cpu") + std::to_string(cpu) + std::string("/topology/thread_siblings_list"));
+		std::string list;
+		std::vector<int> threads;
+		if (!std::getline(siblings, list) || !fldParseCpuList(list, threads)) {
+			physical.push_back(cpu); // Topology not available: assume no siblings
+			continue;
+		}
+		for (const int thread : threads) {
+			if (std::binary_search(candidates.begin(), candidates.end(), thread)) {
+				if (thread == cpu) {
+					physical.push_back(cpu);
+				}
+				break;
+			}
+		}
+	}
+	return physical;
+#else
+	FLD_SDK_PRINT_WARN("Core topology not available on this platform");
+	return cpus;
+#endif /* __linux__ */
+}
+
+/*
+* Pins the calling thread to the provided CPUs. The affinity is inherited by the threads created later
+* which means calling this function before FldSdkEngine::init() pins all the engine's threads.
+* Only available on Linux.
+* @param cpus The logical CPUs to use.
+* @returns true if succeed, false otherwise
+*/
+static bool fldSetAffinity(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const int cpu : cpus) {
+		if (cpu < 0 || cpu >= CPU_SETSIZE) {
+			FLD_SDK_PRINT_ERROR("Invalid CPU index: %d", cpu);
+			return false;
+		}
+		CPU_SET(cpu, &set);
+	}
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		FLD_SDK_PRINT_ERROR("sched_setaffinity failed");
+		return false;
+	}
+	return true;
+#else
+	FLD_SDK_PRINT_ERROR("CPU affinity not supported on this platform");
+	return false;
+#endif /* __linux__ */
+}
+
+/*
+* Memory usage of the process.
+*/
+struct FldMemoryUsage {
+	size_t residentBytes = 0; // Current resident set size (VmRSS)
+	size_t peakResidentBytes = 0; // Peak resident set size since the process started (VmHWM)
+};
+
+/*
+* Reads the memory usage of the process. Only available on Linux.
+* @param usage The memory usage.
+* @returns true if succeed, false otherwise
+*/
+static bool fldMemoryUsage(FldMemoryUsage& usage)
+{
+#if defined(__linux__)
+	std::ifstream status("/proc/self/status");
+	std::string key;
+	size_t valueInKB;
+	bool residentFound = false, peakFound = false;
+	while (status >> key) {
+		if (key == "VmRSS:" && (status >> valueInKB)) {
+			usage.residentBytes = valueInKB << 10;
+			residentFound = true;
+		}
+		else if (key == "VmHWM:" && (status >> valueInKB)) {
+			usage.peakResidentBytes = valueInKB << 10;
+			peakFound = true;
+		}
+	}
+	return residentFound && peakFound;
+#else
+	return false;
+#endif /* __linux__ */
+}
+
+/*
+* Initializes and warms up the engine on a background thread.
+* start() returns immediately: the application could open its health port at once and use status() as readiness probe
+* to admit traffic only when the engine is ready.
+*/
+class FldAsyncLoader {
+public:
+	enum Status {
+		FLD_LOADER_STATUS_IDLE,
+		FLD_LOADER_STATUS_WARMING,
+		FLD_LOADER_STATUS_READY,
+		FLD_LOADER_STATUS_FAILED
+	};
+
+	FldAsyncLoader() : m_eStatus(FLD_LOADER_STATUS_IDLE), m_nWarmedTypes(0) { }
+	virtual ~FldAsyncLoader() {
+		if (m_Thread.joinable()) {
+			m_Thread.join();
+		}
+	}
+
+	/*
+	* Starts the initialization then warms up the engine for each image type.
+	* @param init Function calling FldSdkEngine::init(), called on the background thread.
+	* @param imageTypes Image types to warm up, in order.
+	* @returns true if the loading started, false if already started
+	*/
+	bool start(const std::function<FldSdkResult()>& init, const std::vector<FLD_SDK_IMAGE_TYPE>& imageTypes) {
+		Status expected = FLD_LOADER_STATUS_IDLE;
+		if (!m_eStatus.compare_exchange_strong(expected, FLD_LOADER_STATUS_WARMING)) {
+			FLD_SDK_PRINT_ERROR("Loader already started");
+			return false;
+		}
+		m_Thread = std::thread([this, init, imageTypes]() {
+			FldSdkResult result = init();
+			for (size_t i = 0; i < imageTypes.size() && result.isOK(); ++i) {
+				if ((result = FldSdkEngine::warmUp(imageTypes[i])).isOK()) {
+					m_nWarmedTypes.fetch_add(1);
+				}
+			}
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Result = result;
+			m_eStatus.store(result.isOK() ? FLD_LOADER_STATUS_READY : FLD_LOADER_STATUS_FAILED);
+			m_CondVar.notify_all();
+		});
+		return true;
+	}
+
+	/*
+	* Readiness probe, cheap (single atomic load).
+	*/
+	Status status() const {
+		return m_eStatus.load();
+	}
+
+	/*
+	* Number of image types already warmed up.
+	*/
+	size_t warmedTypes() const {
+		return m_nWarmedTypes.load();
+	}
+
+	/*
+	* Blocks until the engine is ready or failed.
+	* @returns the result of the init or warmup call that failed, "OK" result if ready
+	*/
+	FldSdkResult wait() {
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_CondVar.wait(lock, [this] { return isDone(); });
+		return m_Result;
+	}
+
+	/*
+	* Same as wait() but gives up after the timeout.
+	* @param timeout Maximum time to wait for.
+	* @returns the same as wait(), "Timeout" if still warming
+	*/
+	FldSdkResult waitFor(const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		return m_CondVar.wait_for(lock, timeout, [this] { return isDone(); })
+			? m_Result
+			: FldSdkResult::bodyless(-1, "Timeout");
+	}
+
+private:
+	bool isDone() const {
+		const Status status = m_eStatus.load();
+		return status == FLD_LOADER_STATUS_READY || status == FLD_LOADER_STATUS_FAILED;
+	}
+
+	std::atomic<Status> m_eStatus;
+	std::atomic<size_t> m_nWarmedTypes;
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_CondVar;
+	FldSdkResult m_Result;
+};
+#endif /* _FACE_LIVENESS_SDK_SAMPLES_RUNTIME_UTILS_H_ */
@@ -6,6 +6,10 @@
 */
 #include <FLD-SDK-API-PUBLIC.h>
 
+#include "fld_runtime_utils.h"
+#include "fld_parallel_utils.h"
+#include "fld_dump_utils.h"
+
 #include <chrono>
 #include <vector>
 #include <algorithm>
@@ -14,6 +18,7 @@
 #include <mutex>
 #include <map>
 #include <condition_variable>
+#include <memory>
 #if defined(_WIN32)
 #include <algorithm> // std::replace
 #endif
@@ -44,23 +49,23 @@ struct FldFile {
 * Parallel callback function used for notification. Not mandatory.
 * More info about parallel delivery: https://www.doubango.org/SDKs/anpr/docs/Parallel_versus_sequential_processing.html
 */
-static size_t parallelNotifCount = 0;
-static std::condition_variable parallelNotifCondVar;
+static FldDeliveryTracker deliveryTracker;
 class MyFldSdkParallelDeliveryCallback : public FldSdkParallelDeliveryCallback {
 public:
 	MyFldSdkParallelDeliveryCallback(const void* userData) : m_pMyDummyData(userData) {}
 	virtual void onNewResult(const FldSdkResult* result) const override {
 		// Use m_pMyDummyData here if you want
 		FLD_SDK_ASSERT(result != nullptr);
-		const std::string& json = result->json();
+		// No std::string copy: this is called for every frame and the JSON string is owned by the result
+		const char* json = result->json();
 		// Printing to the console could be very slow and delayed -> stop displaying the result as soon as all faces are processed
 		FLD_SDK_PRINT_INFO("MyFldSdkParallelDeliveryCallback::onNewResult(%d, %s, %zu): %s",
 			result->code(),
 			result->phrase(),
-			++parallelNotifCount,
-			!json.empty() ? json.c_str() : "{}"
+			deliveryTracker.delivered() + 1,
+			(json && *json) ? json : "{}"
 		);
-		parallelNotifCondVar.notify_one();
+		deliveryTracker.onDelivered(); // Last: wakes up flush()
 	}
 private:
 	const void* m_pMyDummyData;
@@ -77,7 +82,6 @@ static const char* __jsonConfig =
 "\"debug_write_input_image_enabled\": false,"
 "\"debug_internal_data_path\": \".\","
 ""
-"\"num_threads\": -1,"
 "\"gpgpu_enabled\": true,"
 "\"max_latency\": -1,"
 "\"image_interpolation\": \"bicubic\","
@@ -87,14 +91,12 @@ static const char* __jsonConfig =
 "\"openvino_enabled\": false,"
 "\"openvino_device\": \"CPU\","
 ""
-"\"detect_tf_num_threads\": -1,"
 "\"detect_tf_gpu_memory_alloc_max_percent\": 0.2,"
 "\"detect_roi\": [0, 0, 0, 0],"
 "\"detect_minscore\": 0.93,"
 "\"detect_face_minsize\": 65,"
 ""
 "\"liveness_detect_enabled\": true,"
-"\"liveness_tf_num_threads\": -1,"
 "\"liveness_tf_gpu_memory_alloc_max_percent\": 0.2,"
 "\"liveness_face_minsize\": 64,"
 "\"liveness_genuine_minscore\": 0.98,"
@@ -102,12 +104,10 @@ static const char* __jsonConfig =
 "\"liveness_toofar_threshold\": 0.5,"
 ""
 "\"deepfake_detect_enabled\": true,"
-"\"deepfake_tf_num_threads\": -1,"
 "\"deepfake_tf_gpu_memory_alloc_max_percent\": 0.2,"
 "\"deepfake_minscore\": 0.5,"
 ""
 "\"disguise_detect_enabled\": true,"
-"\"disguise_tf_num_threads\": -1,"
 "\"disguise_tf_gpu_memory_alloc_max_percent\": 0.2,"
 "\"disguise_minscore\": 0.5"
 ""
@@ -120,8 +120,9 @@ int main(int argc, char *argv[])
 	MyFldSdkParallelDeliveryCallback parallelDeliveryCallbackCallback(nullptr);
 	std::string assetsFolder, licenseTokenData, licenseTokenFile;
 	bool isParallelDeliveryEnabled = true;
-	const size_t numberOfImages = 1;
 	std::string imagePath;
+	FldDumpConfig dumpConfig;
+	bool isDumpEnabled = false;
 
 	// Parsing args
 	std::map<std::string, std::string > args;
@@ -149,6 +150,33 @@ int main(int argc, char *argv[])
 #endif
 	}
 
+	if (args.find("--dump_folder") != args.end()) {
+		dumpConfig.folder = args["--dump_folder"];
+		isDumpEnabled = true;
+	}
+	if (args.find("--dump_verdicts") != args.end()) {
+		const std::string& verdicts = args["--dump_verdicts"];
+		size_t start = 0, end;
+		do {
+			end = verdicts.find(',', start);
+			const std::string verdict = verdicts.substr(start, end == std::string::npos ? std::string::npos : end - start);
+			if (!verdict.empty()) {
+				dumpConfig.verdicts.push_back(verdict);
+			}
+			start = end + 1;
+		} while (end != std::string::npos);
+	}
+	if (!dumpConfig.verdicts.empty()) {
+		if (isParallelDeliveryEnabled) {
+			// The verdict isn't known when the frame is submitted: nothing would ever be dumped
+			printUsage("--dump_verdicts requires --parallel false");
+			return -1;
+		}
+		if (!isDumpEnabled) {
+			FLD_SDK_PRINT_WARN("--dump_verdicts ignored: --dump_folder not set");
+		}
+	}
+
 	if (args.find("--tokenfile") != args.end()) {
 		licenseTokenFile = args["--tokenfile"];
 #if defined(_WIN32)
@@ -162,6 +190,7 @@ int main(int argc, char *argv[])
 
 	// Update JSON config
 	std::string jsonConfig = __jsonConfig;
+	jsonConfig += fldBuildThreadingConfig(0, isParallelDeliveryEnabled).toJson(); // Zero: all the CPUs available to the process
 	if (!assetsFolder.empty()) {
 		jsonConfig += std::string(",\"assets_folder\": \"") + assetsFolder + std::string("\"");
 	}
@@ -174,47 +203,67 @@ int main(int argc, char *argv[])
 
 	jsonConfig += "}"; // end-of-config
 
+	// Input dumper, lives as long as the engine
+	std::unique_ptr<FldInputDumper> dumper;
+	if (isDumpEnabled) {
+		dumper.reset(new FldInputDumper(dumpConfig));
+	}
+
+	// Init and WarmUp in the background: the file is read while the models are loading.
+	// WarmUp: Force loading the models in memory (slow for first time) now and perform warmup calls.
+	// Warmup not required but processing will be fast if you call warm up first.
+	FLD_SDK_PRINT_INFO("Starting liveness sample...");
+	FldAsyncLoader loader;
+	FLD_SDK_ASSERT(loader.start([&jsonConfig, &parallelDeliveryCallbackCallback, isParallelDeliveryEnabled]() {
+		return FldSdkEngine::init(
+			ASSET_MGR_PARAM()
+			jsonConfig.c_str(),
+			isParallelDeliveryEnabled ? &parallelDeliveryCallbackCallback : nullptr
+		);
+	}, { FLD_SDK_IMAGE_TYPE::FLD_SDK_IMAGE_TYPE_RGB24 }));
+
 	// Decode the file
 	FldFile file;
 	if (!readFile(imagePath, file)) {
 		FLD_SDK_PRINT_ERROR("Can't process %s", imagePath.c_str());
+		loader.wait();
+		FldSdkEngine::deInit();
 		return -1;
 	}
 	FLD_SDK_ASSERT(file.isValid());
 
-	// Init
-	FLD_SDK_PRINT_INFO("Starting liveness sample...");
-	FLD_SDK_ASSERT((result = FldSdkEngine::init(
-		ASSET_MGR_PARAM()
-		jsonConfig.c_str(),
-		isParallelDeliveryEnabled ? &parallelDeliveryCallbackCallback : nullptr
-	)).isOK());
-
-	// WarmUp: Force loading the models in memory (slow for first time) now and perform warmup calls.
-	// Warmup not required but processing will be fast if you call warm up first.
-	FLD_SDK_ASSERT((result = FldSdkEngine::warmUp(FLD_SDK_IMAGE_TYPE::FLD_SDK_IMAGE_TYPE_RGB24)).isOK());
+	// Wait until the engine is ready
+	FLD_SDK_ASSERT((result = loader.wait()).isOK());
 
 	// Processing
+	if (isParallelDeliveryEnabled) {
+		deliveryTracker.onSubmitted(); // Before process(): the result could be delivered before the function returns
+	}
 	FLD_SDK_ASSERT((result = FldSdkEngine::process(
 		file.compressedDataPtr,
 		file.compressedDataSize
 	)).isOK());
 
+	// Dump the input in the background instead of using "debug_write_input_image_enabled"
+	// In parallel mode the verdict isn't known yet: only dumped when no verdict filter is set
+	if (dumper) {
+		dumper->dump(file.compressedDataPtr, file.compressedDataSize, "input.bin", isParallelDeliveryEnabled ? nullptr : &result);
+	}
+
 	// Printing to the console is very slow and use a low priority thread.
 	// Wait until all results are displayed.
 	if (isParallelDeliveryEnabled) {
-		static std::mutex parallelNotifMutex;
-		std::unique_lock<std::mutex > lk(parallelNotifMutex);
-		parallelNotifCondVar.wait_for(lk,
-			std::chrono::milliseconds(1500), // maximum number of millis to wait for before giving up, must never wait this long
-			[&numberOfImages] { return (parallelNotifCount == numberOfImages); }
-		);
+		// maximum number of millis to wait for before giving up, must never wait this long
+		const size_t pendingCount = deliveryTracker.flush(std::chrono::milliseconds(1500));
+		if (pendingCount) {
+			FLD_SDK_PRINT_WARN("%zu result(s) still pending", pendingCount);
+		}
 	}
 
 	// Print latest result
-	const std::string& json_ = result.json();
-	if (!json_.empty()) {
-		FLD_SDK_PRINT_INFO("result: %s", json_.c_str());
+	const char* json = result.json();
+	if (json && *json) {
+		FLD_SDK_PRINT_INFO("result: %s", json);
 	}
 
 	FLD_SDK_PRINT_INFO("Press any key to terminate !!");
@@ -222,7 +271,8 @@ int main(int argc, char *argv[])
 
 	// DeInit
 	FLD_SDK_PRINT_INFO("Ending liveness...");
-	FLD_SDK_ASSERT((result = FldSdkEngine::deInit()).isOK());
+	FLD_SDK_ASSERT((result = fldDeInit(isParallelDeliveryEnabled ? &deliveryTracker : nullptr, FLD_DRAIN_POLICY_WAIT, std::chrono::milliseconds(1500))).isOK());
+	dumper.reset(); // Writes the pending inputs
 
 	return 0;
 }
@@ -239,6 +289,8 @@ static void printUsage(const std::string& message /*= ""*/)
 		"\t--image <path-to-image-with-a-face-to-analyse> \n"
 		"\t--assets <path-to-assets-folder> \n"
 		"\t[--parallel <whether-to-enable-parallel-mode:true / false>] \n"
+		"\t[--dump_folder <path-to-folder-where-to-dump-the-input>] \n"
+		"\t[--dump_verdicts <comma-separated-list-of-liveness-codes-to-dump>] \n"
 		"\t[--tokenfile <path-to-license-token-file>] \n"
 		"\t[--tokendata <base64-license-token-data>] \n"
 		"\n"
@@ -247,6 +299,8 @@ static void printUsage(const std::string& message /*= ""*/)
 		"--image: Path to an image(JPEG/PNG/BMP) with a license face. This image will be used to evaluate the liveness detector. You can use default image at ../../../assets/images/disguise.jpg.\n\n"
 		"--assets: Path to the assets folder containing the configuration files and models.\n\n"
 		"--parallel: Whether to enabled the parallel mode. More info about the parallel mode at https ://www.doubango.org/SDKs/anpr/docs/Parallel_versus_sequential_processing.html. Default: true.\n\n"
+		"--dump_folder: Path to an existing folder where to dump the input image from a background thread. Default: null.\n\n"
+		"--dump_verdicts: Only dump the input if one of the faces has a liveness code from this comma-separated list (e.g. s_spoof,s_deepfake). Requires --dump_folder and --parallel false. Default: null.\n\n"
 		"--tokenfile: Path to the file containing the base64 license token if you have one. If not provided then, the application will act like a trial version. Default: null.\n\n"
 		"--tokendata: Base64 license token if you have one. If not provided then, the application will act like a trial version. Default: null.\n\n"
 		"********************************************************************************\n"
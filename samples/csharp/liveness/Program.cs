@@ -151,13 +151,17 @@ namespace liveness
         // https://www.doubango.org/SDKs/mrz/docs/Configuration_options.html
         static String BuildJSON(String assetsFolder = "", String tokenDataBase64 = "")
         {
+            // Number of CPUs available to the process (affinity mask and, on .NET Core 3+ / Linux, the container's CPU quota)
+            // used instead of -1 which sizes the engine's pools from the host core count.
+            // Sequential mode: each model may use all the CPUs available.
+            int numThreads = Environment.ProcessorCount;
             return new JavaScriptSerializer().Serialize(new
             {
                 debug_level = "info",
                 debug_write_input_image_enabled = false,
                 debug_internal_data_path = ".",
                     
-                num_threads = -1,
+                num_threads = numThreads,
                 gpgpu_enabled = true,
                 max_latency = -1,
                 image_interpolation = "bicubic",
@@ -167,14 +171,14 @@ namespace liveness
                 openvino_enabled = false,
                 openvino_device = "CPU",
                     
-                detect_tf_num_threads = -1,
+                detect_tf_num_threads = numThreads,
                 detect_tf_gpu_memory_alloc_max_percent = 0.2,
                 detect_roi = new[] { 0f, 0f, 0f, 0f },
                 detect_minscore = 0.9,
                 detect_face_minsize = 128,
 
                 liveness_detect_enabled = true,
-                liveness_tf_num_threads = -1,
+                liveness_tf_num_threads = numThreads,
                 liveness_tf_gpu_memory_alloc_max_percent = 0.2,
                 liveness_face_minsize = 128,
                 liveness_genuine_minscore = 0.98,
@@ -182,12 +186,12 @@ namespace liveness
                 liveness_toofar_threshold = 0.5,
 
                 deepfake_detect_enabled = true,
-                deepfake_tf_num_threads = -1,
+                deepfake_tf_num_threads = numThreads,
                 deepfake_tf_gpu_memory_alloc_max_percent = 0.2,
                 deepfake_minscore = 0.5,
 
                 disguise_detect_enabled = true,
-                disguise_tf_num_threads = -1,
+                disguise_tf_num_threads = numThreads,
                 disguise_tf_gpu_memory_alloc_max_percent = 0.2,
                 disguise_minscore = 0.5,
 
@@ -137,13 +137,16 @@ public class Liveness {
    // https://www.doubango.org/SDKs/face-liveness/docs/Configuration_options.html
    static String BuildJSON(String assetsFolder, String tokenDataBase64)
    {
+      // Number of CPUs available to the JVM (affinity mask and, since JDK 10 / 8u191, the container's CPU quota)
+      // used instead of -1 which sizes the engine's pools from the host core count.
+      final int numThreads = Runtime.getRuntime().availableProcessors();
       return String.format(
          "{" +
          "\"debug_level\": \"info\"," +
          "\"debug_write_input_image_enabled\": false," +
          "\"debug_internal_data_path\": \".\"," +
          "" +
-         "\"num_threads\": -1," +
+         "\"num_threads\": %d," +
          "\"gpgpu_enabled\": true," +
          "\"max_latency\": -1," +
          "\"image_interpolation\": \"bicubic\"," +
@@ -153,14 +156,14 @@ public class Liveness {
          "\"openvino_enabled\": false," +
          "\"openvino_device\": \"CPU\"," +
          "" +
-         "\"detect_tf_num_threads\": -1," +
+         "\"detect_tf_num_threads\": %d," +
          "\"detect_tf_gpu_memory_alloc_max_percent\": 0.2," +
          "\"detect_roi\": [0, 0, 0, 0]," +
          "\"detect_minscore\": 0.9," +
          "\"detect_face_minsize\": 65," +
          "" +
          "\"liveness_detect_enabled\": true," +
-         "\"liveness_tf_num_threads\": -1," +
+         "\"liveness_tf_num_threads\": %d," +
          "\"liveness_tf_gpu_memory_alloc_max_percent\": 0.2," +
          "\"liveness_face_minsize\": 64," +
          "\"liveness_genuine_minscore\": 0.98," +
@@ -168,12 +171,12 @@ public class Liveness {
          "\"liveness_toofar_threshold\": 0.5," +
          "" +
          "\"deepfake_detect_enabled\": true," +
-         "\"deepfake_tf_num_threads\": -1," +
+         "\"deepfake_tf_num_threads\": %d," +
          "\"deepfake_tf_gpu_memory_alloc_max_percent\": 0.2," +
          "\"deepfake_minscore\": 0.5," +
          "" +
          "\"disguise_detect_enabled\": true," +
-         "\"disguise_tf_num_threads\": -1," +
+         "\"disguise_tf_num_threads\": %d," +
          "\"disguise_tf_gpu_memory_alloc_max_percent\": 0.2," +
          "\"disguise_minscore\": 0.5," +
          "" +
@@ -181,6 +184,8 @@ public class Liveness {
          "\"license_token_data\": \"%s\"" +
          "}"
          , 
+         // Threading: sequential mode, each model may use all the CPUs available
+         numThreads, numThreads, numThreads, numThreads, numThreads,
          // Value added using command line args
          assetsFolder,
          tokenDataBase64
@@ -37,7 +37,6 @@ JSON_CONFIG = {
     "debug_write_input_image_enabled": False,
     "debug_internal_data_path": ".",
 
-    "num_threads": -1,
     "gpgpu_enabled": True,
     "max_latency": -1,
     "mage_interpolation": "bicubic",
@@ -47,14 +46,12 @@ JSON_CONFIG = {
     "openvino_enabled": False,
     "openvino_device": "CPU",
     
-    "detect_tf_num_threads": -1,
     "detect_tf_gpu_memory_alloc_max_percent": 0.2,
     "detect_roi": [0, 0, 0, 0],
     "detect_minscore": 0.9,
     "detect_face_minsize": 64,
     
     "liveness_detect_enabled": False,
-    "liveness_tf_num_threads": -1,
     "liveness_tf_gpu_memory_alloc_max_percent": 0.2,
     "liveness_face_minsize": 64,
     "liveness_genuine_minscore": 0.98,
@@ -62,16 +59,40 @@ JSON_CONFIG = {
     "liveness_toofar_threshold": 0.5,
 
     "deepfake_detect_enabled": True,
-    "deepfake_tf_num_threads": -1,
     "deepfake_tf_gpu_memory_alloc_max_percent": 0.2,
     "deepfake_minscore": DEEPFAKE_MINSCORE_PERCENT,
     
     "disguise_detect_enabled": False,
-    "disguise_tf_num_threads": -1,
     "disguise_tf_gpu_memory_alloc_max_percent": 0.2,
     "disguise_minscore": 0.5
 }
 
+# Number of CPUs available to the process: the smallest of the online CPUs, the CPUs in the affinity mask
+# (taskset, Kubernetes static CPU manager) and the cgroup quota (Docker's "--cpus", Kubernetes CPU limit).
+# Used instead of -1 for the "*num_threads" entries: the engine sizes its pools from the host core count
+# which means heavy throttling in containers with a CPU quota.
+def cpuCount():
+    count = os.cpu_count() or 1
+    if hasattr(os, "sched_getaffinity"):
+        count = min(count, len(os.sched_getaffinity(0)) or count)
+    quota, period = -1, 0
+    try:
+        with open("/sys/fs/cgroup/cpu.max") as file: # cgroup v2
+            values = file.read().split()
+            if values[0] != "max":
+                quota, period = int(values[0]), int(values[1])
+    except (OSError, ValueError, IndexError):
+        for folder in ("/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"): # cgroup v1
+            try:
+                with open(folder + "/cpu.cfs_quota_us") as quotaFile, open(folder + "/cpu.cfs_period_us") as periodFile:
+                    quota, period = int(quotaFile.read()), int(periodFile.read())
+                    break
+            except (OSError, ValueError):
+                pass
+    if quota > 0 and period > 0:
+        count = min(count, (quota + period - 1) // period)
+    return max(count, 1)
+
 TAG = "[PythonDeepfake] "
 
 # Quick&Dirty Tracker (MUST NOT USE, use a real tracker like DeepSort)
@@ -158,6 +179,11 @@ if __name__ == "__main__":
     JSON_CONFIG["license_token_file"] = args.tokenfile
     JSON_CONFIG["license_token_data"] = args.tokendata
 
+    # Threading: sequential mode, each model may use all the CPUs available to the process
+    cpus = cpuCount()
+    for key in ["num_threads", "detect_tf_num_threads", "liveness_tf_num_threads", "deepfake_tf_num_threads", "disguise_tf_num_threads"]:
+        JSON_CONFIG[key] = cpus
+
     # Initialize the engine
     checkResult("Init", 
                 FaceLivenessDetectionSDK.FldSdkEngine_init(json.dumps(JSON_CONFIG))